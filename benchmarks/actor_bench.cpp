@@ -0,0 +1,49 @@
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <sys/resource.h>
+#include <vector>
+
+#include "bench.h"
+#include <async/actor.h>
+#include <async/algorithm.h>
+
+/* Sends messages to many small actors from all workers at once and reports
+ * the message rate and the memory taken per idle actor. */
+
+constexpr std::size_t ACTORS = 100000;
+constexpr std::size_t MESSAGES = 10000000;
+
+long peakRssKiB() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+int main() {
+  std::printf("%8s %16s %14s %12s\n", "threads", "messages/s", "time (ms)",
+              "bytes/actor");
+  for (std::size_t nthreads : bench::threadCounts()) {
+    async::ThreadPool pool(nthreads);
+    pool.prewarm();
+
+    long before = peakRssKiB();
+    std::vector<std::unique_ptr<async::Actor<long>>> actors;
+    actors.reserve(ACTORS);
+    for (std::size_t a = 0; a < ACTORS; a++) {
+      actors.push_back(std::make_unique<async::Actor<long>>(pool));
+    }
+    double per_actor =
+        static_cast<double>(peakRssKiB() - before) * 1024 / ACTORS;
+
+    double seconds = bench::bestOf(1, [&] {
+      async::parallel_for(pool, std::size_t{0}, MESSAGES, [&](std::size_t i) {
+        actors[i % ACTORS]->tell([](long &n) { n++; });
+      });
+      /* Destroying an actor waits for its queued messages. */
+      actors.clear();
+    });
+    std::printf("%8zu %16.0f %14.2f %12.0f\n", nthreads, MESSAGES / seconds,
+                seconds * 1e3, per_actor);
+  }
+}
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+
+#include "bench.h"
+#include <async/threadpool.h>
+
+/* Measures how quickly a single-producer burst spreads over an idle pool:
+ * one worker spawns many tasks of a few microseconds each onto its own deque,
+ * and the time until every worker has run at least one of them is the time to
+ * balance. Compares random stealing alone with the surplus bitmap, with and
+ * without handing surplus tasks to parked workers. */
+
+constexpr int BURST = 100000;
+constexpr auto TASK_TIME = std::chrono::microseconds(2);
+
+void spin(std::chrono::nanoseconds duration) {
+  auto end = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+void run(std::size_t nthreads, async::ThreadPool::WorkSharing sharing,
+         char const *label) {
+  using clock = std::chrono::steady_clock;
+  async::ThreadPool pool(nthreads);
+  pool.set_work_sharing(sharing);
+  pool.prewarm();
+
+  auto first_task = std::make_unique<std::atomic<clock::rep>[]>(nthreads);
+  for (std::size_t i = 0; i < nthreads; i++) {
+    first_task[i] = 0;
+  }
+  clock::time_point start;
+  double total_s = bench::bestOf(1, [&] {
+    pool.submit([&] {
+          start = clock::now();
+          async::TaskGroup group(pool);
+          for (int i = 0; i < BURST; i++) {
+            group.run([&] {
+              auto &first = first_task[async::ThreadPool::current_worker()];
+              if (first.load(std::memory_order_relaxed) == 0) {
+                first.store(clock::now().time_since_epoch().count(),
+                            std::memory_order_relaxed);
+              }
+              spin(TASK_TIME);
+            });
+          }
+          group.wait();
+        }).get();
+  });
+
+  clock::rep balanced = 0;
+  std::size_t reached = 0;
+  for (std::size_t i = 0; i < nthreads; i++) {
+    if (clock::rep t = first_task[i].load()) {
+      balanced = std::max(balanced, t);
+      reached++;
+    }
+  }
+  auto to_balance = clock::time_point(clock::duration(balanced)) - start;
+  auto stats = pool.stats();
+  std::printf("%8zu %16s %16.1f %10zu %12.2f %14llu\n", nthreads, label,
+              std::chrono::duration<double, std::micro>(to_balance).count(),
+              reached, total_s * 1e3,
+              static_cast<unsigned long long>(stats.failed_steals));
+}
+
+int main() {
+  std::printf("%8s %16s %16s %10s %12s %14s\n", "threads", "mode",
+              "balance (us)", "workers", "total (ms)", "failed steals");
+  for (std::size_t nthreads : bench::threadCounts()) {
+    run(nthreads, {}, "random");
+    run(nthreads, {.surplus_threshold = 16}, "surplus");
+    run(nthreads, {.surplus_threshold = 16, .push_to_parked = true},
+        "surplus+push");
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+/**
+ * @brief Runs `f` `reps` times and returns the fastest run in seconds.
+ */
+template <typename F> double bestOf(int reps, F &&f) {
+  double best = std::numeric_limits<double>::max();
+  for (int r = 0; r < reps; r++) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+/**
+ * @brief Returns the thread counts to sweep: powers of two up to, and
+ * including, the number of hardware threads.
+ */
+inline std::vector<std::size_t> threadCounts() {
+  std::size_t hw = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::size_t> counts;
+  for (std::size_t n = 1; n < hw; n *= 2) {
+    counts.push_back(n);
+  }
+  counts.push_back(hw);
+  return counts;
+}
+
+} // namespace bench
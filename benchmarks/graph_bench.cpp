@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include <async/graph.h>
+
+/* Generates the edges of an R-MAT graph with 2^scale vertices. Each edge picks
+ * one quadrant of the adjacency matrix per bit with the Graph500
+ * probabilities, which gives the skewed degree distribution of real networks.
+ * Vertex ids are permuted so that high degree vertices are not clustered. */
+std::vector<std::pair<std::uint32_t, std::uint32_t>>
+rmatEdges(int scale, int edge_factor, std::uint64_t seed) {
+  constexpr double a = 0.57, b = 0.19, c = 0.19;
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+  std::uint32_t n = std::uint32_t{1} << scale;
+  std::vector<std::uint32_t> permutation(n);
+  for (std::uint32_t v = 0; v < n; v++) {
+    permutation[v] = v;
+  }
+  std::shuffle(permutation.begin(), permutation.end(), rng);
+
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> edges(
+      static_cast<std::size_t>(edge_factor) * n);
+  for (auto &[u, v] : edges) {
+    u = v = 0;
+    for (int bit = 0; bit < scale; bit++) {
+      double r = coin(rng);
+      u |= static_cast<std::uint32_t>(r >= a + b) << bit;
+      v |= static_cast<std::uint32_t>((r >= a && r < a + b) || r >= a + b + c)
+           << bit;
+    }
+    u = permutation[u];
+    v = permutation[v];
+  }
+  return edges;
+}
+
+/* Runs BFS from a fixed set of sources over a synthetic R-MAT graph and
+ * reports traversed edges per second (TEPS) for each thread count. Usage:
+ * graph_bench [scale] [edge factor] */
+int main(int argc, char **argv) {
+  int scale = argc > 1 ? std::atoi(argv[1]) : 20;
+  int edge_factor = argc > 2 ? std::atoi(argv[2]) : 16;
+
+  auto graph = async::CsrGraph::fromEdges(std::size_t{1} << scale,
+                                          rmatEdges(scale, edge_factor, 1));
+  std::printf("R-MAT scale %d, edge factor %d: %zu vertices, %zu edges\n",
+              scale, edge_factor, graph.vertices(), graph.edges() / 2);
+
+  /* Sources with at least one edge, picked deterministically. */
+  std::vector<std::uint32_t> sources;
+  std::mt19937 rng(2);
+  while (sources.size() < 16) {
+    std::uint32_t v = rng() % graph.vertices();
+    if (graph.degree(v) > 0) {
+      sources.push_back(v);
+    }
+  }
+
+  std::printf("%8s %12s %10s\n", "threads", "MTEPS", "speedup");
+  double base = 0;
+  for (std::size_t nthreads : bench::threadCounts()) {
+    async::ThreadPool pool(nthreads);
+    std::uint64_t traversed = 0;
+    double seconds = 0;
+    for (std::uint32_t source : sources) {
+      std::vector<std::int64_t> parent;
+      seconds += bench::bestOf(
+          1, [&] { parent = async::parallel_bfs(pool, graph, source); });
+      /* As in Graph500, count the undirected edges inside the reached
+       * component. */
+      std::uint64_t degrees = 0;
+      for (std::uint32_t v = 0; v < graph.vertices(); v++) {
+        if (parent[v] != -1) {
+          degrees += graph.degree(v);
+        }
+      }
+      traversed += degrees / 2;
+    }
+    double teps = traversed / seconds;
+    if (base == 0) {
+      base = teps;
+    }
+    std::printf("%8zu %12.2f %10.2f\n", nthreads, teps * 1e-6, teps / base);
+  }
+}
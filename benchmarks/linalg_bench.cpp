@@ -0,0 +1,46 @@
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include <async/linalg.h>
+
+/* Measures how parallel_gemm and parallel_transpose scale with the number of
+ * workers. Both are recursive fork-join workloads that rely on stealing to
+ * spread the subproblems over the pool. */
+int main() {
+  constexpr std::size_t gemm_n = 1024;
+  constexpr std::size_t transpose_n = 8192;
+
+  std::vector<double> a(gemm_n * gemm_n, 1.0), b(gemm_n * gemm_n, 2.0),
+      c(gemm_n * gemm_n);
+  std::vector<float> src(transpose_n * transpose_n, 1.0f),
+      dst(transpose_n * transpose_n);
+
+  std::printf("%8s %12s %10s %14s %10s\n", "threads", "gemm GFLOP/s",
+              "speedup", "transpose GB/s", "speedup");
+
+  double gemm_base = 0, transpose_base = 0;
+  for (std::size_t nthreads : bench::threadCounts()) {
+    async::ThreadPool pool(nthreads);
+
+    double gemm_s = bench::bestOf(3, [&] {
+      async::parallel_gemm(pool, gemm_n, gemm_n, gemm_n, a.data(), gemm_n,
+                           b.data(), gemm_n, c.data(), gemm_n);
+    });
+    double transpose_s = bench::bestOf(5, [&] {
+      async::parallel_transpose(pool, transpose_n, transpose_n, src.data(),
+                                transpose_n, dst.data(), transpose_n);
+    });
+
+    if (gemm_base == 0) {
+      gemm_base = gemm_s;
+      transpose_base = transpose_s;
+    }
+    double gflops = 2.0 * gemm_n * gemm_n * gemm_n / gemm_s * 1e-9;
+    double gbytes =
+        2.0 * sizeof(float) * transpose_n * transpose_n / transpose_s * 1e-9;
+    std::printf("%8zu %12.2f %10.2f %14.2f %10.2f\n", nthreads, gflops,
+                gemm_base / gemm_s, gbytes, transpose_base / transpose_s);
+  }
+}
@@ -0,0 +1,63 @@
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include <async/logger.h>
+#include <async/threadpool.h>
+
+/* Measures the cost of a log call made from pool tasks: Logger, which copies
+ * the arguments into the worker's ring, against formatting with fprintf into
+ * a stream shared under a mutex. Both write to /dev/null. */
+
+constexpr int RECORDS = 1000000;
+
+/* Calls `log(task, i)` RECORDS times from tasks on `pool`, and prints the time
+ * per call on one worker. */
+template <typename Log>
+void measure(async::ThreadPool &pool, char const *label, Log log) {
+  std::size_t tasks = pool.size() * 8;
+  std::size_t per_task = RECORDS / tasks;
+  pool.prewarm();
+  double seconds = bench::bestOf(3, [&] {
+    async::TaskGroup group(pool);
+    for (std::size_t t = 0; t < tasks; t++) {
+      group.run([&log, t, per_task] {
+        for (std::size_t i = 0; i < per_task; i++) {
+          log(t, i);
+        }
+      });
+    }
+    group.wait();
+  });
+  std::printf("%8zu %10s %12.1f\n", pool.size(), label,
+              seconds * 1e9 * static_cast<double>(pool.size()) /
+                  static_cast<double>(tasks * per_task));
+}
+
+int main() {
+  int null = open("/dev/null", O_WRONLY);
+  std::FILE *stream = fdopen(dup(null), "w");
+  std::printf("%8s %10s %12s\n", "threads", "logger", "ns per call");
+  for (std::size_t nthreads : bench::threadCounts()) {
+    async::ThreadPool pool(nthreads);
+    std::mutex mutex;
+    measure(pool, "fprintf", [&](std::size_t t, std::size_t i) {
+      std::lock_guard lock(mutex);
+      std::fprintf(stream, "task %zu record %zu value %f\n", t, i, 0.5);
+    });
+    async::Logger logger(pool, null, {.ring_records = 1 << 16});
+    measure(pool, "Logger", [&](std::size_t t, std::size_t i) {
+      logger.log("task {} record {} value {}", t, i, 0.5);
+    });
+    if (logger.dropped()) {
+      std::printf("%8s %10s %12llu dropped\n", "", "",
+                  static_cast<unsigned long long>(logger.dropped()));
+    }
+  }
+  std::fclose(stream);
+  close(null);
+}
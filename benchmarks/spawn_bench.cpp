@@ -0,0 +1,104 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include <async/job.h>
+#include <async/threadpool.h>
+
+/* Compares child stealing (TaskGroup: the spawned task is queued and the
+ * parent keeps running) with continuation stealing (Job: the child runs first
+ * and the parent's continuation is queued) on two patterns: recursive fib and
+ * a single loop that spawns many tiny children. Each measurement runs in its
+ * own process so that the peak resident set reflects that variant alone. */
+
+constexpr int FIB_N = 30;
+constexpr int LOOP_N = 2000000;
+
+long fibGroup(async::ThreadPool &pool, int n) {
+  if (n < 2) {
+    return n;
+  }
+  long a = 0;
+  async::TaskGroup group(pool);
+  group.run([&pool, &a, n] { a = fibGroup(pool, n - 1); });
+  long b = fibGroup(pool, n - 2);
+  group.wait();
+  return a + b;
+}
+
+async::Job<long> fibJob(int n) {
+  if (n < 2) {
+    co_return n;
+  }
+  long a = 0, b = 0;
+  co_await async::fork(a, fibJob(n - 1));
+  b = co_await fibJob(n - 2);
+  co_await async::join();
+  co_return a + b;
+}
+
+void loopGroup(async::ThreadPool &pool, std::atomic<long> &sum) {
+  async::TaskGroup group(pool);
+  for (int i = 0; i < LOOP_N; i++) {
+    group.run([&sum] { sum.fetch_add(1, std::memory_order_relaxed); });
+  }
+  group.wait();
+}
+
+async::Job<> addOne(std::atomic<long> &sum) {
+  sum.fetch_add(1, std::memory_order_relaxed);
+  co_return;
+}
+
+async::Job<> loopJob(std::atomic<long> &sum) {
+  for (int i = 0; i < LOOP_N; i++) {
+    co_await async::fork(addOne(sum));
+  }
+  co_await async::join();
+}
+
+/* Runs `f` in a child process and prints its time and peak resident set. */
+template <typename F>
+void measure(std::size_t nthreads, char const *pattern, char const *mode,
+             F f) {
+  std::fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    async::ThreadPool pool(nthreads);
+    pool.prewarm();
+    double seconds = bench::bestOf(1, [&] { f(pool); });
+    std::printf("%8zu %10s %14s %12.2f", nthreads, pattern, mode,
+                seconds * 1e3);
+    std::fflush(stdout);
+    _exit(0);
+  }
+  int status = 0;
+  rusage usage{};
+  wait4(pid, &status, 0, &usage);
+  std::printf(" %14ld\n", usage.ru_maxrss);
+}
+
+int main() {
+  std::printf("%8s %10s %14s %12s %14s\n", "threads", "pattern", "mode",
+              "time (ms)", "peak RSS (KiB)");
+  for (std::size_t nthreads : bench::threadCounts()) {
+    measure(nthreads, "fib", "child-steal", [](async::ThreadPool &pool) {
+      pool.submit([&pool] { return fibGroup(pool, FIB_N); }).get();
+    });
+    measure(nthreads, "fib", "work-first", [](async::ThreadPool &pool) {
+      async::run(pool, fibJob(FIB_N));
+    });
+    measure(nthreads, "loop", "child-steal", [](async::ThreadPool &pool) {
+      std::atomic<long> sum = 0;
+      pool.submit([&] { loopGroup(pool, sum); }).get();
+    });
+    measure(nthreads, "loop", "work-first", [](async::ThreadPool &pool) {
+      std::atomic<long> sum = 0;
+      async::run(pool, loopJob(sum));
+    });
+  }
+}
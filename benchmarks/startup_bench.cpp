@@ -0,0 +1,30 @@
+#include <cstddef>
+#include <cstdio>
+
+#include "bench.h"
+#include <async/threadpool.h>
+
+/* Measures how long it takes to get a pool ready for work: constructing and
+ * destroying an unused pool, constructing one and running its first task, and
+ * constructing one and prewarming all workers. */
+int main() {
+  constexpr int reps = 200;
+
+  std::printf("%8s %16s %20s %18s\n", "threads", "construct (us)",
+              "first task (us)", "prewarm (us)");
+  for (std::size_t nthreads : bench::threadCounts()) {
+    double construct = bench::bestOf(reps, [&] {
+      async::ThreadPool pool(nthreads);
+    });
+    double first_task = bench::bestOf(reps, [&] {
+      async::ThreadPool pool(nthreads);
+      pool.submit([] {}).get();
+    });
+    double prewarm = bench::bestOf(reps, [&] {
+      async::ThreadPool pool(nthreads);
+      pool.prewarm();
+    });
+    std::printf("%8zu %16.2f %20.2f %18.2f\n", nthreads, construct * 1e6,
+                first_task * 1e6, prewarm * 1e6);
+  }
+}
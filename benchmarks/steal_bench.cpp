@@ -0,0 +1,50 @@
+#include <cstddef>
+#include <cstdio>
+
+#include "bench.h"
+#include <async/threadpool.h>
+
+/* Compares the default cap on searching workers against letting every idle
+ * worker steal. Two patterns are measured: single tasks submitted to an idle
+ * pool one at a time, and a burst of small tasks spawned by a single worker.
+ * Fewer failed steals mean fewer CAS operations that lose the race on a
+ * victim's deque. */
+
+void run(std::size_t nthreads, std::size_t max_searching, char const *label) {
+  constexpr int singles = 20000;
+  constexpr int burst = 200000;
+
+  async::ThreadPool pool(nthreads);
+  pool.set_max_searching(max_searching);
+  pool.prewarm();
+
+  double single_s = bench::bestOf(1, [&] {
+    for (int i = 0; i < singles; i++) {
+      pool.submit([] {}).get();
+    }
+  });
+  double burst_s = bench::bestOf(1, [&] {
+    pool.submit([&] {
+          async::TaskGroup group(pool);
+          for (int i = 0; i < burst; i++) {
+            group.run([] {});
+          }
+          group.wait();
+        }).get();
+  });
+
+  auto stats = pool.stats();
+  std::printf("%8zu %10s %14.2f %12.2f %16llu %14llu\n", nthreads, label,
+              single_s / singles * 1e6, burst_s * 1e3,
+              static_cast<unsigned long long>(stats.steal_attempts),
+              static_cast<unsigned long long>(stats.failed_steals));
+}
+
+int main() {
+  std::printf("%8s %10s %14s %12s %16s %14s\n", "threads", "searching",
+              "single (us)", "burst (ms)", "steal attempts", "failed steals");
+  for (std::size_t nthreads : bench::threadCounts()) {
+    run(nthreads, nthreads, "all");
+    run(nthreads, nthreads / 2, "half");
+  }
+}
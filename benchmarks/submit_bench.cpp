@@ -0,0 +1,36 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+
+#include "bench.h"
+#include <async/threadpool.h>
+
+/* Measures the throughput of one thread submitting tiny tasks faster than the
+ * pool drains them, with and without coalescing of submitted tasks. */
+
+constexpr int TASKS = 1000000;
+
+void run(std::size_t nthreads, std::size_t min_depth, char const *label) {
+  async::ThreadPool pool(nthreads);
+  pool.set_coalescing(min_depth);
+  pool.prewarm();
+  std::atomic<long> sum = 0;
+  double seconds = bench::bestOf(3, [&] {
+    async::TaskGroup group(pool);
+    for (int i = 0; i < TASKS; i++) {
+      group.run([&sum] { sum.fetch_add(1, std::memory_order_relaxed); });
+    }
+    group.wait();
+  });
+  std::printf("%8zu %12s %12.2f %14.1f\n", nthreads, label, seconds * 1e3,
+              TASKS / seconds / 1e6);
+}
+
+int main() {
+  std::printf("%8s %12s %12s %14s\n", "threads", "mode", "time (ms)",
+              "Mtasks/s");
+  for (std::size_t nthreads : bench::threadCounts()) {
+    run(nthreads, 0, "one by one");
+    run(nthreads, 64, "coalesced");
+  }
+}
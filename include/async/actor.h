@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <type_traits>
+#include <utility>
+
+#include <async/strand.h>
+#include <async/threadpool.h>
+
+namespace async {
+
+/**
+ * @brief An actor: a piece of state that is only ever touched by the messages
+ * sent to it, one message at a time.
+ *
+ * A message is a callable that receives the state by reference. tell() sends
+ * a message without waiting for it; ask() sends one and returns a future for
+ * its result. Messages from one sender are processed in the order in which
+ * they were sent.
+ *
+ * The mailbox is a Strand: a lock-free MPSC queue that is scheduled onto the
+ * pool only while it holds messages, and is drained up to `batch` messages at
+ * a time by whichever worker picks it up. An idle actor therefore costs its
+ * state plus a few words, and needs no thread or lock of its own.
+ *
+ * @note The actor must outlive the messages sent to it. The destructor waits
+ * for queued messages to be processed, and must not be called from one of
+ * them.
+ *
+ * @tparam State The type of the actor's state.
+ */
+template <typename State> class Actor {
+public:
+  /**
+   * @brief Constructs an actor whose messages are processed on `pool`.
+   *
+   * @param pool The thread pool that processes the messages.
+   * @param state The initial state.
+   * @param batch The most messages processed in a row by one worker.
+   */
+  explicit Actor(ThreadPool &pool, State state = State{},
+                 std::size_t batch = internal::STRAND_BATCH)
+      : state_(std::move(state)), mailbox_(pool, batch) {}
+
+  Actor(Actor const &other) = delete;
+  Actor &operator=(Actor const &other) = delete;
+
+  /**
+   * @brief Sends a message without waiting for it. The message must not
+   * throw; use ask() to receive exceptions.
+   *
+   * @param f The message, called as `f(state)`.
+   */
+  template <std::invocable<State &> F> void tell(F &&f) {
+    mailbox_.post(
+        [this, f = internal::decay_copy(std::forward<F>(f))]() mutable {
+          std::invoke(std::move(f), state_);
+        });
+  }
+
+  /**
+   * @brief Sends a message and returns a future for its result.
+   *
+   * @param f The message, called as `f(state)`.
+   * @return The future object associated with the result of the message.
+   */
+  template <std::invocable<State &> F>
+  std::future<std::invoke_result_t<std::decay_t<F> &&, State &>> ask(F &&f) {
+    return mailbox_.submit(
+        [this, f = internal::decay_copy(std::forward<F>(f))]() mutable {
+          return std::invoke(std::move(f), state_);
+        });
+  }
+
+  /**
+   * @brief Returns the pool that processes the messages.
+   */
+  ThreadPool &pool() const noexcept { return mailbox_.pool(); }
+
+private:
+  State state_;    // Touched only by messages
+  Strand mailbox_; // Destroyed first, so that queued messages see the state
+};
+
+} // namespace async
@@ -0,0 +1,490 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <ranges>
+#include <source_location>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <async/threadpool.h>
+
+namespace async {
+
+/**
+ * @brief How a parallel loop divides its iterations into tasks.
+ */
+enum class Partitioning {
+  /* One contiguous block per worker, decided up front. Lowest overhead when
+   * all iterations cost the same. */
+  Static,
+  /* Workers repeatedly claim the next `grain` iterations from a shared
+   * counter. Balances uneven iterations at the cost of one atomic per chunk. */
+  Dynamic,
+  /* The range is halved recursively down to `grain` and the halves are forked,
+   * so idle workers steal the largest remaining pieces. */
+  Adaptive,
+  /* Like Dynamic, but the grain is learned: every chunk is timed, and the
+   * grain is steered towards chunks of AUTO_CHUNK_TIME. What is learned is
+   * kept per call site for the rest of the process, so later calls start with
+   * a good grain. `grain`, if set, is only used until the first measurement. */
+  Auto,
+};
+
+/**
+ * @brief Tuning knobs for the parallel loops. Passing a different policy
+ * changes how a loop is scheduled without changing what it computes.
+ */
+struct LoopPolicy {
+  std::size_t grain = 0; // Iterations per chunk; 0 picks one automatically
+  Partitioning partitioning = Partitioning::Adaptive;
+};
+
+namespace internal {
+
+/* Number of chunks per worker aimed for when the grain is picked
+ * automatically. A few chunks per worker leave room for stealing to even out
+ * the load. */
+inline constexpr std::size_t CHUNKS_PER_WORKER = 8;
+
+/* Grain used for ranges whose size is not known in advance. */
+inline constexpr std::size_t UNSIZED_GRAIN = 256;
+
+/* Duration of each chunk aimed for by Partitioning::Auto: long enough to make
+ * the cost of scheduling a chunk negligible, short enough to leave many
+ * chunks for stealing. */
+inline constexpr std::chrono::microseconds AUTO_CHUNK_TIME{50};
+
+/**
+ * @brief What Partitioning::Auto has learned about one call site: a moving
+ * average of the time per iteration.
+ *
+ * Updates from concurrent chunks may overwrite each other, which only drops
+ * samples from the average.
+ */
+class GrainTuner {
+public:
+  /**
+   * @brief Returns the average nanoseconds per iteration, or 0 before the
+   * first measurement.
+   */
+  double cost() const noexcept { return cost_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Returns the grain for a loop over `n` iterations, given the
+   * `initial` grain to use while nothing has been measured.
+   */
+  std::size_t grain(ThreadPool const &pool, std::size_t n,
+                    std::size_t initial) const noexcept {
+    double c = cost();
+    if (c == 0) {
+      return initial;
+    }
+    auto target = std::chrono::duration<double, std::nano>(AUTO_CHUNK_TIME);
+    auto grain = static_cast<std::size_t>(target.count() / c);
+    /* Leave every worker at least one chunk. */
+    std::size_t share = (n + pool.size() - 1) / pool.size();
+    return std::clamp<std::size_t>(grain, 1, std::max<std::size_t>(1, share));
+  }
+
+  /**
+   * @brief Records that `count` iterations took `elapsed`.
+   */
+  void record(std::size_t count, std::chrono::nanoseconds elapsed) noexcept {
+    double sample = static_cast<double>(elapsed.count()) /
+                    static_cast<double>(count);
+    double c = cost();
+    /* A sample of 0 would read as "not measured". */
+    sample = std::max(sample, 1e-3);
+    cost_.store(c == 0 ? sample : c + (sample - c) / 8,
+                std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns the tuner of the loop called at `location` with a body of
+   * type `Body`. Loops at different call sites learn separately even if their
+   * bodies have the same type, as function pointers do.
+   */
+  template <typename Body>
+  static GrainTuner &site(std::source_location const &location) {
+    using key_t =
+        std::tuple<std::string_view, std::uint_least32_t, std::uint_least32_t>;
+    static std::mutex mutex;
+    static std::map<key_t, GrainTuner> tuners;
+    std::lock_guard lock(mutex);
+    return tuners
+        .try_emplace(key_t{location.file_name(), location.line(),
+                           location.column()})
+        .first->second;
+  }
+
+private:
+  std::atomic<double> cost_ = 0;
+};
+
+/**
+ * @brief The unsigned type parallel_for() counts indices of type I in.
+ */
+template <std::integral I>
+using loop_unsigned_t =
+    typename std::conditional_t<std::is_same_v<I, bool>,
+                                std::type_identity<unsigned char>,
+                                std::make_unsigned<I>>::type;
+
+/**
+ * @brief Returns the grain to use for a loop over `n` iterations.
+ */
+inline std::size_t loopGrain(ThreadPool const &pool, std::size_t n,
+                             LoopPolicy const &policy) {
+  if (policy.grain) {
+    return policy.grain;
+  }
+  return std::max<std::size_t>(1, n / (pool.size() * CHUNKS_PER_WORKER));
+}
+
+/**
+ * @brief Adaptive partitioning: forks the upper half of [begin, end) until the
+ * remainder is no larger than `grain`, then runs it.
+ */
+template <typename Body>
+void splitRecursive(ThreadPool &pool, std::size_t begin, std::size_t end,
+                    std::size_t grain, Body &body) {
+  TaskGroup group(pool);
+  while (end - begin > grain) {
+    std::size_t mid = begin + (end - begin) / 2;
+    group.run([&pool, &body, mid, end, grain] {
+      splitRecursive(pool, mid, end, grain, body);
+    });
+    end = mid;
+  }
+  body(begin, end);
+  group.wait();
+}
+
+/**
+ * @brief Partitioning::Auto: workers claim chunks from a shared counter, and
+ * the size of each chunk is taken from the tuner, which learns from the time
+ * every chunk takes.
+ */
+template <typename Body>
+void autoChunks(ThreadPool &pool, std::size_t n, LoopPolicy const &policy,
+                Body &body, GrainTuner &tuner) {
+  using clock = std::chrono::steady_clock;
+  /* Loops shorter than a chunk are not worth handing to the pool. */
+  double cost = tuner.cost();
+  auto target = std::chrono::duration<double, std::nano>(AUTO_CHUNK_TIME);
+  if (cost > 0 && cost * static_cast<double>(n) <= target.count()) {
+    body(std::size_t{0}, n);
+    return;
+  }
+
+  std::size_t initial = policy.grain ? policy.grain : 1;
+
+  TaskGroup group(pool);
+  std::atomic<std::size_t> next = 0;
+  for (std::size_t w = 0; w < pool.size(); ++w) {
+    group.run([&, n] {
+      while (true) {
+        std::size_t grain = tuner.grain(pool, n, initial);
+        std::size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+        if (begin >= n) {
+          break;
+        }
+        std::size_t end = std::min(n, begin + grain);
+        auto start = clock::now();
+        body(begin, end);
+        tuner.record(end - begin, clock::now() - start);
+      }
+    });
+  }
+  group.wait();
+}
+
+/**
+ * @brief Calls `body(begin, end)` on chunks covering [0, n) in parallel,
+ * according to `policy`. Returns once every chunk has finished. `site` is the
+ * call site whose tuner Partitioning::Auto uses.
+ */
+template <typename Body>
+void parallelChunks(
+    ThreadPool &pool, std::size_t n, LoopPolicy const &policy, Body body,
+    std::source_location const &site = std::source_location::current()) {
+  if (n == 0) {
+    return;
+  }
+  if (policy.partitioning == Partitioning::Auto) {
+    autoChunks(pool, n, policy, body, GrainTuner::site<Body>(site));
+    return;
+  }
+  std::size_t grain = loopGrain(pool, n, policy);
+  if (n <= grain) {
+    body(std::size_t{0}, n);
+    return;
+  }
+
+  TaskGroup group(pool);
+  std::atomic<std::size_t> next = 0;
+  switch (policy.partitioning) {
+  case Partitioning::Static: {
+    std::size_t nblocks = std::min(pool.size(), (n + grain - 1) / grain);
+    std::size_t block = (n + nblocks - 1) / nblocks;
+    for (std::size_t begin = 0; begin < n; begin += block) {
+      group.run([&body, begin, end = std::min(n, begin + block)] {
+        body(begin, end);
+      });
+    }
+    break;
+  }
+  case Partitioning::Dynamic: {
+    std::size_t nworkers = std::min(pool.size(), (n + grain - 1) / grain);
+    for (std::size_t w = 0; w < nworkers; ++w) {
+      group.run([&body, &next, n, grain] {
+        std::size_t begin;
+        while ((begin = next.fetch_add(grain, std::memory_order_relaxed)) <
+               n) {
+          body(begin, std::min(n, begin + grain));
+        }
+      });
+    }
+    break;
+  }
+  case Partitioning::Adaptive:
+    group.run([&] { splitRecursive(pool, 0, n, grain, body); });
+    break;
+  case Partitioning::Auto:
+    break;
+  }
+  group.wait();
+}
+
+/**
+ * @brief Runs `body(first, count)` on consecutive chunks of a forward range.
+ *
+ * The calling thread walks the range once to find where each chunk starts and
+ * hands the chunk to the pool; the task then walks its own `count` elements.
+ */
+template <std::forward_iterator It, std::sentinel_for<It> S, typename Body>
+void forwardChunks(ThreadPool &pool, It first, S last, std::size_t grain,
+                   Body body) {
+  TaskGroup group(pool);
+  while (first != last) {
+    It chunk_first = first;
+    std::size_t count = 0;
+    for (; first != last && count < grain; ++first) {
+      ++count;
+    }
+    group.run([&body, chunk_first, count] { body(chunk_first, count); });
+  }
+  group.wait();
+}
+
+/**
+ * @brief Returns the grain to use for a forward range, whose size may be
+ * unknown.
+ */
+template <std::ranges::forward_range R>
+std::size_t forwardGrain(ThreadPool const &pool, R &range,
+                         LoopPolicy const &policy) {
+  if constexpr (std::ranges::sized_range<R>) {
+    return loopGrain(pool, static_cast<std::size_t>(std::ranges::size(range)),
+                     policy);
+  } else {
+    return policy.grain ? policy.grain : UNSIZED_GRAIN;
+  }
+}
+
+} // namespace internal
+
+/**
+ * @brief Calls `f(i)` for every index i in [first, last) in parallel.
+ *
+ * @param pool The thread pool that runs the iterations.
+ * @param first The first index.
+ * @param last The index one past the last.
+ * @param f The loop body.
+ * @param policy How the iterations are divided into tasks.
+ * @param site The call site, under which Partitioning::Auto keeps what it
+ * learns.
+ */
+template <std::integral I, std::invocable<I> F>
+void parallel_for(
+    ThreadPool &pool, I first, I last, F f, LoopPolicy policy = {},
+    std::source_location const &site = std::source_location::current()) {
+  if (last <= first) {
+    return;
+  }
+  /* Unsigned arithmetic wraps instead of overflowing, so ranges wider than
+   * the largest value of a signed I, such as INT_MIN..INT_MAX, work too. */
+  using U = internal::loop_unsigned_t<I>;
+  U base = static_cast<U>(first);
+  U count = static_cast<U>(last) - base;
+  internal::parallelChunks(
+      pool, static_cast<std::size_t>(count), policy,
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          std::invoke(f, static_cast<I>(static_cast<U>(base + i)));
+        }
+      },
+      site);
+}
+
+/**
+ * @brief Calls `f` on every element of `range` in parallel.
+ *
+ * Random-access ranges are partitioned by index according to `policy`. Other
+ * forward ranges are walked once by the calling thread and handed to the pool
+ * in chunks of `policy.grain` elements; the partitioning is ignored for them.
+ *
+ * @param pool The thread pool that runs the iterations.
+ * @param range The elements to visit.
+ * @param f The function to apply to each element.
+ * @param policy How the elements are divided into tasks.
+ * @param site The call site, under which Partitioning::Auto keeps what it
+ * learns.
+ */
+template <std::ranges::forward_range R, typename F>
+  requires std::invocable<F &, std::ranges::range_reference_t<R>>
+void for_each(
+    ThreadPool &pool, R &&range, F f, LoopPolicy policy = {},
+    std::source_location const &site = std::source_location::current()) {
+  if constexpr (std::ranges::random_access_range<R> &&
+                std::ranges::sized_range<R>) {
+    auto first = std::ranges::begin(range);
+    using diff_t = std::ranges::range_difference_t<R>;
+    internal::parallelChunks(
+        pool, static_cast<std::size_t>(std::ranges::size(range)), policy,
+        [&](std::size_t begin, std::size_t end) {
+          for (auto it = first + static_cast<diff_t>(begin),
+                    stop = first + static_cast<diff_t>(end);
+               it != stop; ++it) {
+            std::invoke(f, *it);
+          }
+        },
+        site);
+  } else {
+    internal::forwardChunks(
+        pool, std::ranges::begin(range), std::ranges::end(range),
+        internal::forwardGrain(pool, range, policy),
+        [&](auto it, std::size_t count) {
+          for (; count; --count, ++it) {
+            std::invoke(f, *it);
+          }
+        });
+  }
+}
+
+/**
+ * @brief Writes `f(x)` for every element x of `in` to the sequence starting at
+ * `out`, in parallel.
+ *
+ * Random-access inputs and outputs are partitioned by index according to
+ * `policy`. Otherwise both sequences are walked once by the calling thread and
+ * handed to the pool in chunks of `policy.grain` elements.
+ *
+ * @param pool The thread pool that runs the iterations.
+ * @param in The input elements.
+ * @param out The beginning of the output sequence, which must have room for
+ * as many elements as `in`.
+ * @param f The function to apply to each element.
+ * @param policy How the elements are divided into tasks.
+ * @param site The call site, under which Partitioning::Auto keeps what it
+ * learns.
+ * @return O The iterator one past the last element written.
+ */
+template <std::ranges::forward_range R, std::forward_iterator O, typename F>
+  requires std::indirectly_writable<
+      O, std::indirect_result_t<F &, std::ranges::iterator_t<R>>>
+O transform(
+    ThreadPool &pool, R &&in, O out, F f, LoopPolicy policy = {},
+    std::source_location const &site = std::source_location::current()) {
+  if constexpr (std::ranges::random_access_range<R> &&
+                std::ranges::sized_range<R> && std::random_access_iterator<O>) {
+    auto first = std::ranges::begin(in);
+    std::size_t n = static_cast<std::size_t>(std::ranges::size(in));
+    using in_diff_t = std::ranges::range_difference_t<R>;
+    using out_diff_t = std::iter_difference_t<O>;
+    internal::parallelChunks(
+        pool, n, policy, [&](std::size_t begin, std::size_t end) {
+          auto src = first + static_cast<in_diff_t>(begin);
+          auto dst = out + static_cast<out_diff_t>(begin);
+          for (std::size_t i = begin; i < end; ++i, ++src, ++dst) {
+            *dst = std::invoke(f, *src);
+          }
+        },
+        site);
+    return out + static_cast<out_diff_t>(n);
+  } else {
+    /* Walk the output alongside the input so each chunk knows where to
+     * write. */
+    struct Cursor {
+      std::ranges::iterator_t<R> src;
+      O dst;
+    };
+    std::size_t grain = internal::forwardGrain(pool, in, policy);
+    TaskGroup group(pool);
+    auto src = std::ranges::begin(in);
+    auto last = std::ranges::end(in);
+    while (src != last) {
+      Cursor chunk{src, out};
+      std::size_t count = 0;
+      for (; src != last && count < grain; ++src, ++out) {
+        ++count;
+      }
+      group.run([&f, chunk, count]() mutable {
+        for (std::size_t i = 0; i < count; ++i, ++chunk.src, ++chunk.dst) {
+          *chunk.dst = std::invoke(f, *chunk.src);
+        }
+      });
+    }
+    group.wait();
+    return out;
+  }
+}
+
+/**
+ * @brief Calls `f(i)` for every index i in [first, last) in parallel on
+ * this_pool().
+ */
+template <std::integral I, std::invocable<I> F>
+void parallel_for(
+    I first, I last, F f, LoopPolicy policy = {},
+    std::source_location const &site = std::source_location::current()) {
+  parallel_for(this_pool(), first, last, std::move(f), policy, site);
+}
+
+/**
+ * @brief Calls `f` on every element of `range` in parallel on this_pool().
+ */
+template <std::ranges::forward_range R, typename F>
+  requires std::invocable<F &, std::ranges::range_reference_t<R>>
+void for_each(
+    R &&range, F f, LoopPolicy policy = {},
+    std::source_location const &site = std::source_location::current()) {
+  for_each(this_pool(), std::forward<R>(range), std::move(f), policy, site);
+}
+
+/**
+ * @brief Writes `f(x)` for every element x of `in` to the sequence starting at
+ * `out`, in parallel on this_pool().
+ */
+template <std::ranges::forward_range R, std::forward_iterator O, typename F>
+  requires std::indirectly_writable<
+      O, std::indirect_result_t<F &, std::ranges::iterator_t<R>>>
+O transform(
+    R &&in, O out, F f, LoopPolicy policy = {},
+    std::source_location const &site = std::source_location::current()) {
+  return transform(this_pool(), std::forward<R>(in), std::move(out),
+                   std::move(f), policy, site);
+}
+
+} // namespace async
@@ -0,0 +1,146 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cerrno>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <async/internal/mpsc.h>
+#include <async/threadpool.h>
+
+namespace async {
+
+/**
+ * @brief A queue of results that an external event loop waits for through a
+ * file descriptor, instead of blocking a thread on futures.
+ *
+ * Tasks post results from any thread; the event loop watches fd() for
+ * readability, e.g. with epoll or poll(), and calls drain() when it becomes
+ * readable. Only the first post after a drain writes to the eventfd, and one
+ * drain takes every queued result, so a burst of completions costs one
+ * write() on the posting side and one read() on the loop's side, however
+ * large the burst is.
+ *
+ * @note One thread drains the queue. The queue must outlive the tasks that
+ * post to it.
+ *
+ * @tparam T The type of the results.
+ */
+template <typename T> class CompletionQueue {
+public:
+  /**
+   * @brief Creates the queue and its eventfd.
+   *
+   * @throws std::system_error if the eventfd cannot be created.
+   */
+  CompletionQueue() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (fd_ < 0) {
+      throw std::system_error(errno, std::system_category(),
+                              "eventfd failed");
+    }
+  }
+
+  CompletionQueue(CompletionQueue const &other) = delete;
+  CompletionQueue &operator=(CompletionQueue const &other) = delete;
+
+  /**
+   * @brief Returns the file descriptor that is readable while results are
+   * waiting to be drained. It must not be read or closed by the caller.
+   */
+  int fd() const noexcept { return fd_; }
+
+  /**
+   * @brief Queues a result constructed from `args`. Safe to call from any
+   * thread.
+   */
+  template <typename... Args> void post(Args &&... args) {
+    queue_.push(std::forward<Args>(args)...);
+    /* The exchange also publishes the push to the drain that resets the
+     * flag. */
+    if (!signaled_.exchange(true, std::memory_order_acq_rel)) {
+      signal();
+    }
+  }
+
+  /**
+   * @brief Runs `f(args...)` on the pool and posts the result.
+   *
+   * @param pool The pool that runs the task.
+   * @param f The task function, which must not throw.
+   * @param args The arguments to be passed to the task function.
+   */
+  template <typename... Args, typename F>
+    requires std::constructible_from<
+        T, std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+  void submit(ThreadPool &pool, F &&f, Args &&... args) {
+    pool.spawn([this, task = internal::bindFunctionToArguments(
+                          std::forward<F>(f),
+                          std::forward<Args>(args)...)]() mutable {
+      post(std::invoke(std::move(task)));
+    });
+  }
+
+  /**
+   * @brief Calls `f` on queued results, oldest first, and clears the fd's
+   * readiness. Call it from the event loop when fd() is readable; results
+   * posted while it runs are either taken too or signaled again.
+   *
+   * @param f Called with each result, as an rvalue.
+   * @param max The most results to take; the fd stays readable if more are
+   * left.
+   * @return The number of results taken.
+   */
+  template <std::invocable<T &&> F>
+  std::size_t drain(F &&f,
+                    std::size_t max = std::numeric_limits<std::size_t>::max()) {
+    std::uint64_t count;
+    while (read(fd_, &count, sizeof count) > 0) {
+    }
+    signaled_.exchange(false, std::memory_order_acq_rel);
+    std::size_t taken = 0;
+    while (taken < max) {
+      std::optional<T> result = queue_.pop();
+      if (!result) {
+        return taken;
+      }
+      std::invoke(f, std::move(*result));
+      ++taken;
+    }
+    /* Stopped early: make the loop come back for the rest. */
+    if (!signaled_.exchange(true, std::memory_order_acq_rel)) {
+      signal();
+    }
+    return taken;
+  }
+
+  /**
+   * @brief Destructor. Results that were not drained are destroyed.
+   */
+  ~CompletionQueue() { close(fd_); }
+
+private:
+  int fd_;                       // eventfd, readable while signaled
+  internal::MpscQueue<T> queue_; // Posted results
+  std::atomic<bool> signaled_ = false; // fd_ written since the last drain
+
+  void signal() {
+    std::uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = write(fd_, &one, sizeof one);
+  }
+};
+
+} // namespace async
+
+#endif // defined(__linux__)
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <thread>
+
+#if defined(__linux__)
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#endif
+
+namespace async {
+
+namespace internal {
+
+#if defined(__linux__)
+
+/**
+ * @brief Returns the number of CPUs the calling thread may run on, or nullopt
+ * if the affinity mask cannot be read.
+ */
+inline std::optional<std::size_t> affinityCpuCount() {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return std::nullopt;
+  }
+  return static_cast<std::size_t>(CPU_COUNT(&set));
+}
+
+/**
+ * @brief Converts a CFS quota and period into a whole number of CPUs, rounding
+ * up. A non-positive quota means no limit.
+ */
+inline std::optional<std::size_t> quotaToCpus(long long quota,
+                                              long long period) {
+  if (quota <= 0 || period <= 0) {
+    return std::nullopt;
+  }
+  return static_cast<std::size_t>((quota + period - 1) / period);
+}
+
+/**
+ * @brief Reads the CPU limit from a cgroup v2 `cpu.max` file, which holds
+ * "<quota> <period>" or "max <period>".
+ */
+inline std::optional<std::size_t> readCpuMax(std::string const &path) {
+  std::ifstream file(path);
+  std::string quota;
+  long long period = 0;
+  long long value = 0;
+  if (!(file >> quota >> period) || !(std::istringstream(quota) >> value)) {
+    return std::nullopt; /* Missing file, or "max" */
+  }
+  return quotaToCpus(value, period);
+}
+
+/**
+ * @brief Reads the CPU limit from the cgroup v1 `cpu.cfs_quota_us` and
+ * `cpu.cfs_period_us` files in `dir`.
+ */
+inline std::optional<std::size_t> readCfsQuota(std::string const &dir) {
+  std::ifstream quota_file(dir + "/cpu.cfs_quota_us");
+  std::ifstream period_file(dir + "/cpu.cfs_period_us");
+  long long quota = 0, period = 0;
+  if (!(quota_file >> quota) || !(period_file >> period)) {
+    return std::nullopt;
+  }
+  return quotaToCpus(quota, period);
+}
+
+/**
+ * @brief Returns the tightest limit found in the cgroup `relative` below
+ * `root` and in each of its ancestors, since a parent's quota also caps its
+ * children.
+ */
+template <typename Reader>
+std::optional<std::size_t> cgroupHierarchyLimit(std::string const &root,
+                                                std::string relative,
+                                                Reader read) {
+  std::optional<std::size_t> limit;
+  while (true) {
+    if (auto cpus = read(root + relative)) {
+      limit = std::min(limit.value_or(*cpus), *cpus);
+    }
+    if (relative.empty() || relative == "/") {
+      break;
+    }
+    relative.erase(relative.find_last_of('/'));
+  }
+  return limit;
+}
+
+/**
+ * @brief Returns the number of CPUs allowed by the CPU controller of the
+ * calling process's cgroup, or nullopt if there is no limit.
+ *
+ * Both cgroup v2 (`cpu.max`) and v1 (`cpu.cfs_quota_us`) are looked up under
+ * their usual mount points. Inside a container the cgroup namespace makes the
+ * process's own cgroup appear at the root of the mount, which is reached
+ * while walking up the hierarchy.
+ */
+inline std::optional<std::size_t> cgroupCpuLimit() {
+  std::ifstream cgroups("/proc/self/cgroup");
+  std::string line;
+  std::optional<std::size_t> limit;
+  auto tighten = [&limit](std::optional<std::size_t> cpus) {
+    if (cpus) {
+      limit = std::min(limit.value_or(*cpus), *cpus);
+    }
+  };
+
+  /* Each line is "<id>:<controllers>:<path>". */
+  while (std::getline(cgroups, line)) {
+    std::size_t first = line.find(':');
+    std::size_t second = line.find(':', first + 1);
+    if (first == std::string::npos || second == std::string::npos) {
+      continue;
+    }
+    std::string controllers = line.substr(first + 1, second - first - 1);
+    std::string path = line.substr(second + 1);
+
+    if (controllers.empty()) {
+      auto read = [](std::string const &dir) {
+        return readCpuMax(dir + "/cpu.max");
+      };
+      tighten(cgroupHierarchyLimit("/sys/fs/cgroup", path, read));
+    } else if (("," + controllers + ",").find(",cpu,") != std::string::npos) {
+      for (std::string root :
+           {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"}) {
+        tighten(cgroupHierarchyLimit(root, path, readCfsQuota));
+      }
+    }
+  }
+  return limit;
+}
+
+#endif
+
+} // namespace internal
+
+/**
+ * @brief Returns the number of worker threads that can run in parallel without
+ * oversubscribing the CPUs available to this process.
+ *
+ * On Linux this is the smallest of the number of CPUs in the calling thread's
+ * affinity mask and the CPU quota of the process's cgroup (v1 or v2), rounded
+ * up. Elsewhere it is `std::thread::hardware_concurrency()`. The result is at
+ * least 1.
+ *
+ * The limits are read again on every call rather than cached, so callers that
+ * need to follow changes of the quota can call this again and size new pools
+ * from the result.
+ */
+inline std::size_t recommended_concurrency() {
+  std::size_t cpus = std::thread::hardware_concurrency();
+#if defined(__linux__)
+  if (auto affinity = internal::affinityCpuCount()) {
+    cpus = *affinity;
+  }
+  if (auto quota = internal::cgroupCpuLimit()) {
+    cpus = std::min(cpus, *quota);
+  }
+#endif
+  return std::max<std::size_t>(cpus, 1);
+}
+
+} // namespace async
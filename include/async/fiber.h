@@ -0,0 +1,274 @@
+#pragma once
+
+#include <async/internal/context.h>
+
+#if ASYNC_FIBERS_SUPPORTED
+
+#include <atomic>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <async/threadpool.h>
+
+namespace async {
+
+namespace internal {
+
+/* Usable stack of each fiber, not counting its guard page. */
+inline constexpr std::size_t FIBER_STACK_BYTES = 64 * 1024;
+
+/* Most free stacks each thread keeps for reuse. */
+inline constexpr std::size_t FIBER_STACK_CACHE = 16;
+
+/**
+ * @brief A fiber stack: FIBER_STACK_BYTES of memory above a guard page that
+ * turns an overflow into a crash instead of silent corruption.
+ */
+struct FiberStack {
+  void *base = nullptr; // Start of the mapping, i.e. of the guard page
+  std::size_t size = 0; // Size of the mapping
+
+  void *top() const noexcept { return static_cast<char *>(base) + size; }
+};
+
+/**
+ * @brief Per-thread cache of free fiber stacks, so that starting a fiber does
+ * not map and unmap memory each time.
+ */
+class FiberStackCache {
+public:
+  FiberStack allocate() {
+    if (!free_.empty()) {
+      FiberStack stack = free_.back();
+      free_.pop_back();
+      return stack;
+    }
+    std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t size = (FIBER_STACK_BYTES + page - 1) / page * page + page;
+    /* Pages are only committed when the fiber touches them. */
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE,
+                      -1, 0);
+    if (base == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    if (mprotect(base, page, PROT_NONE) != 0) {
+      munmap(base, size);
+      throw std::bad_alloc();
+    }
+    return {base, size};
+  }
+
+  void release(FiberStack stack) {
+    if (free_.size() < FIBER_STACK_CACHE) {
+      free_.push_back(stack);
+    } else {
+      munmap(stack.base, stack.size);
+    }
+  }
+
+  ~FiberStackCache() {
+    for (FiberStack const &stack : free_) {
+      munmap(stack.base, stack.size);
+    }
+  }
+
+  /**
+   * @brief Returns the cache of the calling thread.
+   */
+  static FiberStackCache &local() {
+    static thread_local FiberStackCache cache;
+    return cache;
+  }
+
+private:
+  std::vector<FiberStack> free_;
+};
+
+/**
+ * @brief Gives fibers access to the scheduler of ThreadPool.
+ */
+struct FiberAccess {
+  /* Queues `f` to run on worker `worker` only. */
+  template <std::invocable F>
+  static void resumeOn(ThreadPool &pool, std::size_t worker, F &&f) {
+    pool.pushAffine(worker, Affinity::Hard, std::forward<F>(f));
+  }
+
+  /* Counts the fibers parked on the calling worker, which keeps running
+   * until they have finished. */
+  static std::size_t &parkedFibers(ThreadPool &pool) {
+    return pool.queues_[ThreadPool::current_worker()].fibers;
+  }
+};
+
+/**
+ * @brief A task running on its own stack, which can switch back to the worker
+ * that runs it whenever it would block.
+ *
+ * A fiber owns itself: it is started by a pool task, and deletes itself once
+ * its task has finished.
+ */
+class Fiber {
+public:
+  template <typename F>
+  Fiber(ThreadPool &pool, F &&f) : pool_(pool), task_(std::forward<F>(f)) {}
+
+  Fiber(Fiber const &other) = delete;
+  Fiber &operator=(Fiber const &other) = delete;
+
+  /**
+   * @brief Runs the fiber until it finishes or parks. A parked fiber is
+   * resumed on the calling worker once it is woken, so that the thread-local
+   * state it saw before parking stays valid; the worker is free to run other
+   * tasks, or to park itself, in the meantime.
+   */
+  void resume() {
+    if (!stack_.base) {
+      stack_ = FiberStackCache::local().allocate();
+      sp_ = makeContext(stack_.top(), &Fiber::entry, this);
+    }
+    if (parked_) {
+      parked_ = false;
+      --FiberAccess::parkedFibers(pool_);
+    }
+    /* Off the pool (e.g. on a thread that helps in wait()) there is nowhere to
+     * resume a parked fiber, so waits block that thread instead. */
+    bool on_pool = ThreadPool::current() == &pool_;
+    if (on_pool) {
+      worker_ = ThreadPool::current_worker();
+    }
+    Fiber *outer = current_;
+    FiberContext const *outer_context = current_fiber;
+    current_ = this;
+    current_fiber = on_pool ? &context_ : nullptr;
+    switchContext(&caller_sp_, sp_);
+    current_ = outer;
+    current_fiber = outer_context;
+
+    if (finished_) {
+      FiberStackCache::local().release(stack_);
+      delete this;
+      return;
+    }
+    int running = RUNNING;
+    if (state_.compare_exchange_strong(running, PARKED,
+                                       std::memory_order_acq_rel)) {
+      parked_ = true;
+      ++FiberAccess::parkedFibers(pool_);
+      return;
+    }
+    /* Woken before it got to park. */
+    state_.store(RUNNING, std::memory_order_relaxed);
+    FiberAccess::resumeOn(pool_, worker_, [this] { resume(); });
+  }
+
+private:
+  using task_t = fu2::unique_function<void() &&>;
+
+  static constexpr int RUNNING = 0; // Running, or about to park
+  static constexpr int PARKED = 1;  // Parked until its waker is called
+  static constexpr int WOKEN = 2;   // Woken before it parked
+
+  ThreadPool &pool_;      // Pool whose workers run the fiber
+  task_t task_;           // Run on the fiber's stack
+  FiberStack stack_;      // Allocated on first resume
+  void *sp_ = nullptr;    // Saved stack pointer of the fiber
+  void *caller_sp_;       // Saved stack pointer of the worker that resumed it
+  bool finished_ = false; // Set once the task has returned
+  bool parked_ = false;   // Counted in its worker's parked fibers
+  std::size_t worker_ = 0;             // Worker that resumed it last
+  std::atomic<int> state_ = RUNNING;   // Written by the waker too
+  FiberContext const context_{{this, &Fiber::wake}, &Fiber::park};
+
+  static inline thread_local Fiber *current_ = nullptr; // Fiber being run
+
+  /**
+   * @brief Entry point on the fiber's stack.
+   */
+  static void entry(void *arg) {
+    Fiber *self = static_cast<Fiber *>(arg);
+    {
+      task_t task = std::move(self->task_);
+      std::invoke(std::move(task));
+    }
+    self->finished_ = true;
+    switchContext(&self->sp_, self->caller_sp_);
+    assert(false && "finished fiber resumed");
+  }
+
+  /**
+   * @brief Parks the running fiber: switches back to the worker, which
+   * resumes the fiber once it has been woken.
+   */
+  static void park() {
+    Fiber *self = current_;
+    switchContext(&self->sp_, self->caller_sp_);
+  }
+
+  /**
+   * @brief Wakes a fiber that parked, or is about to park, from any thread.
+   */
+  static void wake(void *fiber) {
+    Fiber *self = static_cast<Fiber *>(fiber);
+    if (self->state_.exchange(WOKEN, std::memory_order_acq_rel) == PARKED) {
+      self->state_.store(RUNNING, std::memory_order_relaxed);
+      FiberAccess::resumeOn(self->pool_, self->worker_,
+                            [self] { self->resume(); });
+    }
+  }
+};
+
+} // namespace internal
+
+/**
+ * @brief Submits a task that runs on a fiber: a small stack of its own, with a
+ * guard page, taken from a per-thread cache.
+ *
+ * Blocking waits on the library's primitives inside the task — waiting on a
+ * LightweightSemaphore, locking a Mutex, ThreadPool::wait() on a future, and
+ * waiting for a TaskGroup or Strand — park the fiber instead of blocking its
+ * worker, which runs other work, including other fibers, or parks itself. A
+ * signal on the semaphore or mutex wakes the fiber directly; waits for a
+ * future, TaskGroup or Strand check again after a short, growing delay. This
+ * lets code that was written against blocking calls run on the pool without
+ * tying up a worker per waiting task.
+ *
+ * A fiber that has parked once always resumes on the same worker, so
+ * thread-local state stays valid across waits. Waits that the library cannot
+ * see, such as std::future::get() or std::mutex, still block the worker; call
+ * ThreadPool::wait() on a future before getting it.
+ *
+ * @note The stack holds FIBER_STACK_BYTES, which suits code that does not
+ * keep large buffers on the stack. Only available on x86-64 and aarch64 Linux,
+ * where ASYNC_FIBERS_SUPPORTED is 1.
+ *
+ * @param pool The pool that runs the fiber.
+ * @param f The task function to be executed.
+ * @param args The arguments to be passed to the task function.
+ * @return The future object associated with the task result.
+ */
+template <typename... Args, typename F>
+std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+submit_fiber(ThreadPool &pool, F &&f, Args &&... args) {
+  auto task = internal::Task(internal::bindFunctionToArguments(
+      std::forward<F>(f), std::forward<Args>(args)...));
+  auto future = task.get_future();
+  auto *fiber = new internal::Fiber(pool, std::move(task));
+  pool.spawn([fiber] { fiber->resume(); });
+  return future;
+}
+
+} // namespace async
+
+#endif // ASYNC_FIBERS_SUPPORTED
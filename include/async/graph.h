@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <async/algorithm.h>
+#include <async/threadpool.h>
+
+namespace async {
+
+/**
+ * @brief An undirected graph in compressed sparse row (CSR) form.
+ *
+ * The neighbors of vertex v are neighbors[offsets[v]] up to, but excluding,
+ * neighbors[offsets[v + 1]]. Every edge is stored in both directions.
+ */
+struct CsrGraph {
+  std::vector<std::uint64_t> offsets;   // Start of each adjacency list
+  std::vector<std::uint32_t> neighbors; // Concatenated adjacency lists
+
+  /**
+   * @brief Returns the number of vertices.
+   */
+  std::size_t vertices() const noexcept {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+  }
+
+  /**
+   * @brief Returns the number of stored (directed) edges, twice the number of
+   * undirected edges.
+   */
+  std::size_t edges() const noexcept { return neighbors.size(); }
+
+  /**
+   * @brief Returns the number of neighbors of vertex `v`.
+   */
+  std::size_t degree(std::uint32_t v) const noexcept {
+    return offsets[v + 1] - offsets[v];
+  }
+
+  /**
+   * @brief Builds a graph with `n` vertices from a list of undirected edges.
+   * Self loops are dropped.
+   *
+   * @param n The number of vertices. Every endpoint must be less than `n`.
+   * @param edges The edges as pairs of endpoints.
+   * @return CsrGraph The graph.
+   */
+  static CsrGraph
+  fromEdges(std::size_t n,
+            std::span<std::pair<std::uint32_t, std::uint32_t> const> edges) {
+    CsrGraph g;
+    g.offsets.assign(n + 1, 0);
+    for (auto [u, v] : edges) {
+      if (u != v) {
+        ++g.offsets[u + 1];
+        ++g.offsets[v + 1];
+      }
+    }
+    for (std::size_t v = 0; v < n; ++v) {
+      g.offsets[v + 1] += g.offsets[v];
+    }
+    g.neighbors.resize(g.offsets[n]);
+    std::vector<std::uint64_t> fill(g.offsets.begin(), g.offsets.end() - 1);
+    for (auto [u, v] : edges) {
+      if (u != v) {
+        g.neighbors[fill[u]++] = v;
+        g.neighbors[fill[v]++] = u;
+      }
+    }
+    return g;
+  }
+};
+
+namespace internal {
+
+/* Beamer's heuristic: switch from top-down to bottom-up once the frontier's
+ * outgoing edges exceed 1/BFS_ALPHA of the edges left unexplored. */
+inline constexpr std::uint64_t BFS_ALPHA = 14;
+
+/* Switch back to top-down once the frontier holds fewer than 1/BFS_BETA of
+ * the vertices and is shrinking. */
+inline constexpr std::uint64_t BFS_BETA = 24;
+
+/* Words of the frontier bitmap scanned by one bottom-up chunk; 64 vertices per
+ * word. */
+inline constexpr std::size_t BFS_BITMAP_GRAIN = 16;
+
+/* Frontier vertices expanded by one top-down chunk. */
+inline constexpr std::size_t BFS_QUEUE_GRAIN = 64;
+
+/**
+ * @brief State of a direction-optimizing breadth-first search.
+ *
+ * The frontier is kept either as a queue of vertices (top-down steps) or as a
+ * bitmap (bottom-up steps). Both kinds of step split their work into small
+ * chunks that are forked onto the pool, so uneven degrees are balanced by
+ * work stealing.
+ */
+class Bfs {
+public:
+  Bfs(ThreadPool &pool, CsrGraph const &graph)
+      : pool_(pool), graph_(graph), n_(graph.vertices()),
+        words_((n_ + 63) / 64), parent_(n_, -1), queue_(n_), next_queue_(n_),
+        bitmap_(words_), next_bitmap_(words_) {}
+
+  std::vector<std::int64_t> run(std::uint32_t source) {
+    parent_[source] = source;
+    queue_[0] = source;
+    queue_size_ = 1;
+
+    std::uint64_t edges_to_check = graph_.edges();
+    std::uint64_t scout_count = graph_.degree(source);
+    bool top_down = true;
+
+    while (queue_size_ > 0) {
+      if (top_down && scout_count > edges_to_check / BFS_ALPHA) {
+        /* The frontier is large: switch to bottom-up until it shrinks. */
+        queueToBitmap();
+        std::uint64_t previous, awake = queue_size_;
+        do {
+          previous = awake;
+          awake = bottomUpStep();
+          std::swap(bitmap_, next_bitmap_);
+        } while (awake >= previous || awake > n_ / BFS_BETA);
+        bitmapToQueue();
+        scout_count = 1;
+      } else {
+        edges_to_check -= scout_count;
+        scout_count = topDownStep();
+      }
+    }
+    return std::move(parent_);
+  }
+
+private:
+  ThreadPool &pool_;
+  CsrGraph const &graph_;
+  std::size_t n_;     // Number of vertices
+  std::size_t words_; // Number of words in each bitmap
+
+  std::vector<std::int64_t> parent_;       // BFS tree, -1 if not reached
+  std::vector<std::uint32_t> queue_;       // Frontier as a queue
+  std::vector<std::uint32_t> next_queue_;  // Next frontier as a queue
+  std::size_t queue_size_ = 0;             // Number of vertices in queue_
+  std::vector<std::uint64_t> bitmap_;      // Frontier as a bitmap
+  std::vector<std::uint64_t> next_bitmap_; // Next frontier as a bitmap
+
+  /**
+   * @brief Expands every frontier vertex along its edges. Returns the number
+   * of edges leaving the next frontier.
+   */
+  std::uint64_t topDownStep() {
+    std::atomic<std::size_t> tail = 0;
+    std::atomic<std::uint64_t> scout_count = 0;
+    internal::parallelChunks(
+        pool_, queue_size_, {BFS_QUEUE_GRAIN, Partitioning::Adaptive},
+        [&](std::size_t begin, std::size_t end) {
+          /* Collect the newly discovered vertices locally and append them to
+           * the next queue in one reservation. */
+          std::vector<std::uint32_t> found;
+          std::uint64_t scouts = 0;
+          for (std::size_t q = begin; q < end; ++q) {
+            std::uint32_t u = queue_[q];
+            for (std::uint64_t e = graph_.offsets[u]; e < graph_.offsets[u + 1];
+                 ++e) {
+              std::uint32_t v = graph_.neighbors[e];
+              std::atomic_ref<std::int64_t> parent(parent_[v]);
+              std::int64_t expected = -1;
+              if (parent.load(std::memory_order_relaxed) == -1 &&
+                  parent.compare_exchange_strong(expected, u,
+                                                 std::memory_order_relaxed)) {
+                found.push_back(v);
+                scouts += graph_.degree(v);
+              }
+            }
+          }
+          std::size_t at = tail.fetch_add(found.size());
+          std::copy(found.begin(), found.end(), next_queue_.begin() + at);
+          scout_count.fetch_add(scouts, std::memory_order_relaxed);
+        });
+    std::swap(queue_, next_queue_);
+    queue_size_ = tail.load();
+    return scout_count.load();
+  }
+
+  /**
+   * @brief Lets every unvisited vertex look for a parent in the frontier.
+   * Returns the size of the next frontier.
+   *
+   * Each chunk owns whole words of the next bitmap, so the bitmap is written
+   * without atomics.
+   */
+  std::uint64_t bottomUpStep() {
+    std::atomic<std::uint64_t> awake = 0;
+    internal::parallelChunks(
+        pool_, words_, {BFS_BITMAP_GRAIN, Partitioning::Adaptive},
+        [&](std::size_t begin, std::size_t end) {
+          std::uint64_t count = 0;
+          for (std::size_t w = begin; w < end; ++w) {
+            std::uint64_t word = 0;
+            std::size_t last = std::min(n_, (w + 1) * 64);
+            for (std::size_t v = w * 64; v < last; ++v) {
+              if (parent_[v] != -1) {
+                continue;
+              }
+              for (std::uint64_t e = graph_.offsets[v];
+                   e < graph_.offsets[v + 1]; ++e) {
+                std::uint32_t u = graph_.neighbors[e];
+                if (bitmap_[u / 64] & (std::uint64_t{1} << (u % 64))) {
+                  parent_[v] = u;
+                  word |= std::uint64_t{1} << (v % 64);
+                  ++count;
+                  break;
+                }
+              }
+            }
+            next_bitmap_[w] = word;
+          }
+          awake.fetch_add(count, std::memory_order_relaxed);
+        });
+    return awake.load();
+  }
+
+  void queueToBitmap() {
+    std::fill(bitmap_.begin(), bitmap_.end(), 0);
+    for (std::size_t q = 0; q < queue_size_; ++q) {
+      bitmap_[queue_[q] / 64] |= std::uint64_t{1} << (queue_[q] % 64);
+    }
+  }
+
+  void bitmapToQueue() {
+    queue_size_ = 0;
+    for (std::size_t w = 0; w < words_; ++w) {
+      for (std::uint64_t word = bitmap_[w]; word; word &= word - 1) {
+        queue_[queue_size_++] =
+            static_cast<std::uint32_t>(w * 64 + std::countr_zero(word));
+      }
+    }
+  }
+};
+
+} // namespace internal
+
+/**
+ * @brief Computes a breadth-first search tree of `graph` from `source` in
+ * parallel.
+ *
+ * The search is direction-optimizing: small frontiers are expanded top-down
+ * along their edges, while large frontiers are processed bottom-up, with every
+ * unvisited vertex looking for any neighbor in the frontier bitmap.
+ *
+ * @param pool The thread pool that runs the search.
+ * @param graph The graph to search.
+ * @param source The vertex to start from.
+ * @return std::vector<std::int64_t> The parent of each vertex in the tree. The
+ * source is its own parent and unreachable vertices have parent -1.
+ */
+inline std::vector<std::int64_t>
+parallel_bfs(ThreadPool &pool, CsrGraph const &graph, std::uint32_t source) {
+  return internal::Bfs(pool, graph).run(source);
+}
+
+} // namespace async
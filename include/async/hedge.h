@@ -0,0 +1,239 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+#include <async/internal/timer.h>
+#include <async/threadpool.h>
+
+namespace async {
+
+namespace internal {
+
+/**
+ * @brief Returns what `f` returns, passing it `token` if it takes one.
+ */
+template <typename F>
+decltype(auto) invokeWithToken(F &f, std::stop_token token) {
+  if constexpr (std::invocable<F &, std::stop_token>) {
+    return std::invoke(f, std::move(token));
+  } else {
+    return std::invoke(f);
+  }
+}
+
+template <typename F>
+using hedged_result_t = std::decay_t<decltype(invokeWithToken(
+    std::declval<F &>(), std::declval<std::stop_token>()))>;
+
+/**
+ * @brief Returns the worker that gets the next hedged task submitted from
+ * outside a pool, rotating over `nworkers` workers.
+ */
+inline std::size_t nextHedgeWorker(std::size_t nworkers) {
+  static std::atomic<std::size_t> next = 0;
+  return next.fetch_add(1, std::memory_order_relaxed) % nworkers;
+}
+
+/**
+ * @brief The race between the attempts of a hedged task: the first attempt
+ * to finish sets the promise and asks the other one to stop.
+ */
+template <typename F> class HedgedRace {
+public:
+  using result_t = hedged_result_t<F>;
+
+  /**
+   * @param pool The pool that runs the attempts.
+   * @param f The task.
+   * @param first_worker The worker whose queue the first attempt is pushed to.
+   */
+  HedgedRace(ThreadPool &pool, F f, std::size_t first_worker)
+      : pool_(pool), f_(std::move(f)), first_worker_(first_worker) {}
+
+  /**
+   * @brief Sets the timer entry that starts the duplicate, so that it can be
+   * canceled once the first attempt has finished. Called before the first
+   * attempt is pushed.
+   */
+  void set_timer(Timer::Handle timer) { timer_ = timer; }
+
+  std::future<result_t> get_future() { return promise_.get_future(); }
+
+  /**
+   * @brief Runs attempt `i` (0 for the first, 1 for the duplicate).
+   */
+  void attempt(std::size_t i) {
+    if (done_.load(std::memory_order_acquire)) {
+      return; // The other attempt won while this one was queued
+    }
+    if (i == 0 && ThreadPool::current() == &pool_) {
+      /* Another worker may have stolen it. */
+      first_worker_.store(ThreadPool::current_worker(),
+                          std::memory_order_relaxed);
+    }
+    try {
+      F f = f_;
+      if constexpr (std::is_void_v<result_t>) {
+        invokeWithToken(f, stops_[i].get_token());
+        finish(i, [this] { promise_.set_value(); });
+      } else {
+        result_t result = invokeWithToken(f, stops_[i].get_token());
+        finish(i, [&] { promise_.set_value(std::move(result)); });
+      }
+    } catch (...) {
+      fail(i, std::current_exception());
+    }
+  }
+
+  /**
+   * @brief Called by the timer: starts the duplicate unless the first attempt
+   * has finished already. The duplicate goes to a worker other than the one
+   * running the first attempt or, if that has not started, the one it is
+   * queued on. It is sent with submit_to(), which unlike spawn() may be called
+   * from any thread.
+   */
+  void hedge(std::shared_ptr<HedgedRace> self) {
+    int pending = PENDING;
+    if (!hedge_.compare_exchange_strong(pending, LAUNCHED,
+                                        std::memory_order_acq_rel)) {
+      return;
+    }
+    std::size_t worker =
+        (first_worker_.load(std::memory_order_relaxed) + 1) % pool_.size();
+    (void)pool_.submit_to(worker, Affinity::Soft,
+                          [self = std::move(self)] { self->attempt(1); });
+  }
+
+private:
+  static constexpr int PENDING = 0;   // The duplicate may still start
+  static constexpr int LAUNCHED = 1;  // The duplicate was started
+  static constexpr int CANCELED = 2;  // The first attempt finished in time
+
+  ThreadPool &pool_;
+  F f_; // Copied by each attempt, so that they share no state
+  std::promise<result_t> promise_;
+  std::stop_source stops_[2];
+  std::atomic<bool> done_ = false; // Set by the winner
+  std::atomic<int> hedge_ = PENDING;
+  std::atomic<int> failures_ = 0;
+  std::atomic<std::size_t> first_worker_;
+  Timer::Handle timer_;
+
+  /**
+   * @brief Called by the first attempt once it has finished or failed: keeps
+   * the duplicate from starting and drops the timer's reference to the race.
+   *
+   * @return Whether the duplicate had not started yet.
+   */
+  bool cancelHedge() {
+    int pending = PENDING;
+    if (!hedge_.compare_exchange_strong(pending, CANCELED,
+                                        std::memory_order_acq_rel)) {
+      return false;
+    }
+    Timer::global().cancel(timer_);
+    return true;
+  }
+
+  template <typename Set> void finish(std::size_t i, Set &&set) {
+    if (i == 0) {
+      cancelHedge();
+    }
+    if (!done_.exchange(true, std::memory_order_acq_rel)) {
+      set();
+      stops_[1 - i].request_stop();
+    }
+  }
+
+  /**
+   * @brief Reports a failed attempt. The task fails only once every attempt
+   * that started has failed; it then reports the last error.
+   */
+  void fail(std::size_t i, std::exception_ptr error) {
+    int attempts = 2;
+    if (i == 0 && cancelHedge()) {
+      attempts = 1;
+    }
+    if (failures_.fetch_add(1, std::memory_order_acq_rel) + 1 == attempts &&
+        !done_.exchange(true, std::memory_order_acq_rel)) {
+      promise_.set_exception(std::move(error));
+    }
+  }
+};
+
+} // namespace internal
+
+/**
+ * @brief Submits an idempotent task, and submits a duplicate of it to another
+ * worker if the first has not finished after `after`. The future gets the
+ * result of whichever finishes first.
+ *
+ * Meant for tasks that are occasionally slow for reasons unrelated to their
+ * input, such as cold caches or page faults: a duplicate started on another
+ * worker usually finishes first, which cuts the tail latency for the cost of
+ * running a few tasks twice. Each attempt works on its own copy of `f`.
+ *
+ * If `f` takes a std::stop_token, the losing attempt is asked to stop through
+ * it once the other one has finished, and should return early; its result is
+ * discarded. An attempt that is still queued when the other one finishes
+ * does not run at all. The task fails only if every attempt that started has
+ * failed.
+ *
+ * @note The pool must outlive the returned future's readiness. Durations are
+ * timed by a thread shared by the process.
+ *
+ * @param pool The pool that runs the attempts.
+ * @param f The task, invocable as `f(std::stop_token)` or `f()`.
+ * @param after How long to wait for the first attempt before starting the
+ * duplicate.
+ * @return The future object associated with the task result.
+ */
+template <typename F, typename Rep, typename Period>
+  requires std::copy_constructible<std::decay_t<F>>
+std::future<internal::hedged_result_t<std::decay_t<F>>>
+submit_hedged(ThreadPool &pool, F &&f,
+              std::chrono::duration<Rep, Period> after) {
+  using race_t = internal::HedgedRace<std::decay_t<F>>;
+  /* Inside the pool the first attempt goes to the calling worker's deque.
+   * Outside it is pushed to a chosen worker, so that the duplicate can avoid
+   * that worker's queue. */
+  bool inside = ThreadPool::current() == &pool;
+  std::size_t first_worker = inside ? ThreadPool::current_worker()
+                                    : internal::nextHedgeWorker(pool.size());
+  auto race = std::make_shared<race_t>(pool, std::forward<F>(f), first_worker);
+  auto future = race->get_future();
+  race->set_timer(internal::Timer::global().schedule(
+      internal::Timer::clock::now() +
+          std::chrono::duration_cast<internal::Timer::clock::duration>(after),
+      [race]() mutable { race->hedge(race); }));
+  if (inside) {
+    pool.spawn([race] { race->attempt(0); });
+  } else {
+    (void)pool.submit_to(first_worker, Affinity::Soft,
+                         [race] { race->attempt(0); });
+  }
+  return future;
+}
+
+/**
+ * @brief Submits an idempotent task to this_pool(), with a duplicate started
+ * after `after`; see submit_hedged(ThreadPool &, F &&, duration).
+ */
+template <typename F, typename Rep, typename Period>
+  requires std::copy_constructible<std::decay_t<F>>
+std::future<internal::hedged_result_t<std::decay_t<F>>>
+submit_hedged(F &&f, std::chrono::duration<Rep, Period> after) {
+  return submit_hedged(this_pool(), std::forward<F>(f), after);
+}
+
+} // namespace async
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <type_traits>
+#include <vector>
+
+#include <async/internal/utility.h>
+#include <async/threadpool.h>
+
+namespace async {
+
+namespace internal {
+
+/* Number of samples whose bin indices are computed in one batch before the
+ * counts are scattered. The index buffer stays in L1 and the index loop is
+ * branch-free, so the compiler can vectorize it. */
+inline constexpr std::size_t HISTOGRAM_BATCH = 256;
+
+/* Smallest number of samples worth handing to a separate task. */
+inline constexpr std::size_t HISTOGRAM_MIN_CHUNK = 16 * HISTOGRAM_BATCH;
+
+/* Upper bound on the total size of the privatized copies of the bins. Above
+ * this the copies no longer fit in cache and merging them costs more than the
+ * contention they avoid, so shared atomic bins are used instead. */
+inline constexpr std::size_t HISTOGRAM_PRIVATIZE_LIMIT = std::size_t{1} << 24;
+
+/**
+ * @brief Integral types whose samples can be counted by value. bool has no
+ * unsigned counterpart and only two values, so it is left out.
+ */
+template <typename T>
+concept CountableSample =
+    std::integral<T> && !std::same_as<std::remove_cv_t<T>, bool>;
+
+/**
+ * @brief Maps an integral sample to the bin of the same value. Samples outside
+ * [0, bins) are mapped to the overflow bin at index `bins`.
+ */
+struct CountingBinner {
+  std::size_t bins;
+
+  template <CountableSample T> std::size_t operator()(T v) const noexcept {
+    /* Negative samples wrap around to large values and land in the overflow
+     * bin together with the samples that are too large. */
+    auto u = static_cast<std::make_unsigned_t<T>>(v);
+    return u < bins ? static_cast<std::size_t>(u) : bins;
+  }
+};
+
+/**
+ * @brief Maps a sample to one of `bins` equal width bins covering [lo, hi).
+ * Samples outside the range (and NaNs) are mapped to the overflow bin at index
+ * `bins`.
+ */
+template <typename T> struct RangeBinner {
+  using compute_t = std::conditional_t<std::is_floating_point_v<T>, T, double>;
+
+  std::size_t bins;
+  compute_t lo;
+  compute_t hi;
+  compute_t scale;
+
+  std::size_t operator()(T v) const noexcept {
+    compute_t x = static_cast<compute_t>(v);
+    /* Rounding can carry samples just below hi past the last bin. */
+    return x >= lo && x < hi
+               ? std::min(static_cast<std::size_t>((x - lo) * scale), bins - 1)
+               : bins;
+  }
+};
+
+/**
+ * @brief Counts the samples in [first, first + n) into `counts`, which must
+ * hold `bins + 1` counters including the overflow bin.
+ *
+ * Bin indices are computed a batch at a time into a small buffer, then the
+ * counters are incremented in a second pass. Separating the two keeps the
+ * arithmetic out of the dependency chain through memory.
+ */
+template <std::random_access_iterator It, typename Binner, typename Counter>
+void histogramKernel(It first, std::size_t n, Binner binner, Counter *counts) {
+  std::size_t idx[HISTOGRAM_BATCH];
+  for (std::size_t base = 0; base < n; base += HISTOGRAM_BATCH) {
+    std::size_t m = std::min(HISTOGRAM_BATCH, n - base);
+    It batch = first + static_cast<std::iter_difference_t<It>>(base);
+    for (std::size_t i = 0; i < m; ++i) {
+      idx[i] = binner(batch[static_cast<std::iter_difference_t<It>>(i)]);
+    }
+    for (std::size_t i = 0; i < m; ++i) {
+      if constexpr (std::is_same_v<Counter, std::atomic<std::uint64_t>>) {
+        counts[idx[i]].fetch_add(1, std::memory_order_relaxed);
+      } else {
+        ++counts[idx[i]];
+      }
+    }
+  }
+}
+
+/**
+ * @brief Splits the samples into one chunk per worker and histograms them on
+ * the pool.
+ *
+ * Each chunk counts into its own copy of the bins, padded to a whole number of
+ * cache lines so that no two workers write to the same line. The copies are
+ * then combined pairwise in log2(chunks) rounds. When the copies would be too
+ * large, all chunks count into one array of atomic bins instead.
+ */
+template <std::ranges::random_access_range R, typename Binner>
+std::vector<std::uint64_t> parallelHistogram(ThreadPool &pool, R const &data,
+                                             std::size_t bins, Binner binner) {
+  auto first = std::ranges::begin(data);
+  std::size_t n = static_cast<std::size_t>(std::ranges::size(data));
+  std::size_t nchunks =
+      std::clamp<std::size_t>(n / HISTOGRAM_MIN_CHUNK, 1, pool.size());
+  std::size_t chunk = (n + nchunks - 1) / nchunks;
+
+  auto forEachChunk = [&](auto &&body) {
+    TaskGroup group(pool);
+    for (std::size_t c = 0; c < nchunks; ++c) {
+      std::size_t begin = std::min(n, c * chunk);
+      std::size_t count = std::min(n, begin + chunk) - begin;
+      group.run([=, &body]() {
+        body(c,
+             first + static_cast<std::iter_difference_t<decltype(first)>>(
+                         begin),
+             count);
+      });
+    }
+    group.wait();
+  };
+
+  std::vector<std::uint64_t> result(bins);
+  std::size_t stride = roundUpToCacheLine<std::uint64_t>(bins + 1);
+
+  if (nchunks > 1 &&
+      stride * nchunks * sizeof(std::uint64_t) > HISTOGRAM_PRIVATIZE_LIMIT) {
+    /* Too many bins to privatize: share one array of atomic counters. */
+    auto shared = std::make_unique<std::atomic<std::uint64_t>[]>(bins + 1);
+    forEachChunk([&](std::size_t, auto it, std::size_t count) {
+      histogramKernel(it, count, binner, shared.get());
+    });
+    for (std::size_t b = 0; b < bins; ++b) {
+      result[b] = shared[b].load(std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+  auto local = makeCacheAligned<std::uint64_t>(stride * nchunks);
+  forEachChunk([&](std::size_t c, auto it, std::size_t count) {
+    histogramKernel(it, count, binner, local.get() + c * stride);
+  });
+
+  /* Tree reduction: in each round, copy i absorbs copy i + step. */
+  for (std::size_t step = 1; step < nchunks; step <<= 1) {
+    TaskGroup group(pool);
+    for (std::size_t i = 0; i + step < nchunks; i += 2 * step) {
+      group.run([&, i, step]() {
+        std::uint64_t *dst = local.get() + i * stride;
+        std::uint64_t const *src = local.get() + (i + step) * stride;
+        for (std::size_t b = 0; b < bins; ++b) {
+          dst[b] += src[b];
+        }
+      });
+    }
+    group.wait();
+  }
+
+  std::copy_n(local.get(), bins, result.begin());
+  return result;
+}
+
+} // namespace internal
+
+/**
+ * @brief Counts integral samples (other than bool) by value in parallel.
+ *
+ * Sample `v` is counted in bin `v`. Samples outside [0, bins) are ignored.
+ *
+ * @param pool The thread pool that runs the counting tasks.
+ * @param data The samples.
+ * @param bins The number of bins.
+ * @return std::vector<std::uint64_t> The count of each bin.
+ */
+template <std::ranges::random_access_range R>
+  requires internal::CountableSample<std::ranges::range_value_t<R>>
+std::vector<std::uint64_t> parallel_histogram(ThreadPool &pool, R const &data,
+                                              std::size_t bins) {
+  return internal::parallelHistogram(pool, data, bins,
+                                     internal::CountingBinner{bins});
+}
+
+/**
+ * @brief Builds a histogram of `bins` equal width bins over [lo, hi) in
+ * parallel.
+ *
+ * Samples outside [lo, hi) are ignored.
+ *
+ * @param pool The thread pool that runs the counting tasks.
+ * @param data The samples.
+ * @param bins The number of bins.
+ * @param lo The inclusive lower bound of the first bin.
+ * @param hi The exclusive upper bound of the last bin.
+ * @return std::vector<std::uint64_t> The count of each bin.
+ */
+template <std::ranges::random_access_range R,
+          typename T = std::ranges::range_value_t<R>>
+  requires std::is_arithmetic_v<T>
+std::vector<std::uint64_t> parallel_histogram(ThreadPool &pool, R const &data,
+                                              std::size_t bins,
+                                              std::type_identity_t<T> lo,
+                                              std::type_identity_t<T> hi) {
+  assert(lo < hi && "Histogram range must not be empty");
+  using binner_t = internal::RangeBinner<T>;
+  using compute_t = typename binner_t::compute_t;
+  compute_t scale = static_cast<compute_t>(bins) /
+                    (static_cast<compute_t>(hi) - static_cast<compute_t>(lo));
+  return internal::parallelHistogram(
+      pool, data, bins,
+      binner_t{bins, static_cast<compute_t>(lo), static_cast<compute_t>(hi),
+               scale});
+}
+
+/**
+ * @brief Counts integral samples by value in parallel on this_pool().
+ */
+template <std::ranges::random_access_range R>
+  requires internal::CountableSample<std::ranges::range_value_t<R>>
+std::vector<std::uint64_t> parallel_histogram(R const &data, std::size_t bins) {
+  return parallel_histogram(this_pool(), data, bins);
+}
+
+/**
+ * @brief Builds a histogram of equal width bins over [lo, hi) in parallel on
+ * this_pool().
+ */
+template <std::ranges::random_access_range R,
+          typename T = std::ranges::range_value_t<R>>
+  requires std::is_arithmetic_v<T>
+std::vector<std::uint64_t> parallel_histogram(R const &data, std::size_t bins,
+                                              std::type_identity_t<T> lo,
+                                              std::type_identity_t<T> hi) {
+  return parallel_histogram<R, T>(this_pool(), data, bins, lo, hi);
+}
+
+} // namespace async
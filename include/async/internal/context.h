@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/* Stack switching is written by hand for the platforms below, so that
+ * switching fibers costs a few register moves instead of the signal mask
+ * system call made by swapcontext(). */
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define ASYNC_FIBERS_SUPPORTED 1
+#else
+#define ASYNC_FIBERS_SUPPORTED 0
+#endif
+
+#if ASYNC_FIBERS_SUPPORTED
+
+extern "C" {
+/* Saves the callee-saved registers on the current stack, stores the stack
+ * pointer in `*from`, and restores the registers saved on the stack `to`. */
+void async_internal_switch_context(void **from, void *to);
+
+/* First return address of a new context: calls the entry function with its
+ * argument, both left in callee-saved registers by makeContext(). */
+void async_internal_context_start();
+}
+
+/* Defined weak so that every translation unit including this header may emit
+ * them. */
+#if defined(__x86_64__)
+asm(R"(
+  .pushsection .text
+  .weak async_internal_switch_context
+  .type async_internal_switch_context, @function
+async_internal_switch_context:
+  pushq %rbp
+  pushq %rbx
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %rbx
+  popq %rbp
+  ret
+  .size async_internal_switch_context, .-async_internal_switch_context
+
+  .weak async_internal_context_start
+  .type async_internal_context_start, @function
+async_internal_context_start:
+  movq %r12, %rdi
+  callq *%r13
+  ud2
+  .size async_internal_context_start, .-async_internal_context_start
+  .popsection
+)");
+#elif defined(__aarch64__)
+asm(R"(
+  .pushsection .text
+  .weak async_internal_switch_context
+  .type async_internal_switch_context, %function
+async_internal_switch_context:
+  sub sp, sp, #160
+  stp x19, x20, [sp, #0]
+  stp x21, x22, [sp, #16]
+  stp x23, x24, [sp, #32]
+  stp x25, x26, [sp, #48]
+  stp x27, x28, [sp, #64]
+  stp x29, x30, [sp, #80]
+  stp d8, d9, [sp, #96]
+  stp d10, d11, [sp, #112]
+  stp d12, d13, [sp, #128]
+  stp d14, d15, [sp, #144]
+  mov x9, sp
+  str x9, [x0]
+  mov sp, x1
+  ldp x19, x20, [sp, #0]
+  ldp x21, x22, [sp, #16]
+  ldp x23, x24, [sp, #32]
+  ldp x25, x26, [sp, #48]
+  ldp x27, x28, [sp, #64]
+  ldp x29, x30, [sp, #80]
+  ldp d8, d9, [sp, #96]
+  ldp d10, d11, [sp, #112]
+  ldp d12, d13, [sp, #128]
+  ldp d14, d15, [sp, #144]
+  add sp, sp, #160
+  ret
+  .size async_internal_switch_context, .-async_internal_switch_context
+
+  .weak async_internal_context_start
+  .type async_internal_context_start, %function
+async_internal_context_start:
+  mov x0, x19
+  blr x20
+  brk #0
+  .size async_internal_context_start, .-async_internal_context_start
+  .popsection
+)");
+#endif
+
+namespace async {
+namespace internal {
+
+/**
+ * @brief Prepares the stack ending at `top` so that switching to it calls
+ * `entry(arg)`. The entry function must never return; it leaves by switching
+ * to another context.
+ *
+ * @return The stack pointer to pass to switchContext().
+ */
+inline void *makeContext(void *top, void (*entry)(void *), void *arg) {
+  auto aligned = reinterpret_cast<std::uintptr_t>(top) & ~std::uintptr_t{15};
+  auto *frame = reinterpret_cast<std::uintptr_t *>(aligned);
+#if defined(__x86_64__)
+  /* Popped by the switch, from the stack pointer up: MXCSR and x87 control
+   * word, r15, r14, r13, r12, rbx, rbp, and the return address. The return
+   * leaves the stack 16-byte aligned, as a call expects. */
+  frame -= 10;
+  std::uint32_t fpu[2] = {0x1F80, 0x037F};
+  std::memcpy(&frame[0], fpu, sizeof fpu);
+  frame[1] = frame[2] = frame[5] = frame[6] = 0;
+  frame[3] = reinterpret_cast<std::uintptr_t>(entry); // r13
+  frame[4] = reinterpret_cast<std::uintptr_t>(arg);   // r12
+  frame[7] = reinterpret_cast<std::uintptr_t>(&async_internal_context_start);
+#elif defined(__aarch64__)
+  /* x19 to x30 followed by d8 to d15; x30 is the return address. */
+  frame -= 20;
+  std::memset(frame, 0, 20 * sizeof(std::uintptr_t));
+  frame[0] = reinterpret_cast<std::uintptr_t>(arg);   // x19
+  frame[1] = reinterpret_cast<std::uintptr_t>(entry); // x20
+  frame[11] = reinterpret_cast<std::uintptr_t>(&async_internal_context_start);
+#endif
+  return frame;
+}
+
+/**
+ * @brief Saves the current context in `*from` and continues the context whose
+ * stack pointer is `to`.
+ */
+inline void switchContext(void **from, void *to) {
+  async_internal_switch_context(from, to);
+}
+
+} // namespace internal
+} // namespace async
+
+#endif // ASYNC_FIBERS_SUPPORTED
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace async {
+namespace internal {
+
+/**
+ * @class MpscQueue
+ * @brief An unbounded lock-free queue with many producers and one consumer.
+ *
+ * This is Vyukov's intrusive MPSC queue: push() swaps the new node into the
+ * tail with a single atomic exchange and then links the previous tail to it,
+ * so producers never wait for each other or for the consumer. Between those
+ * two steps the new node is not reachable yet, and pop() returns nullopt even
+ * though the push has begun. Callers that keep a separate count of pushed
+ * elements must retry in that case.
+ *
+ * @tparam T type of the elements stored in the queue
+ */
+template <typename T> class MpscQueue {
+public:
+  MpscQueue() : head_(new Node), tail_(head_) {}
+
+  MpscQueue(MpscQueue const &other) = delete;
+  MpscQueue &operator=(MpscQueue const &other) = delete;
+
+  /**
+   * @brief Appends an element. Safe to call from any thread.
+   */
+  template <typename... Args> void push(Args &&... args) {
+    Node *node = new Node;
+    node->value.emplace(std::forward<Args>(args)...);
+    Node *prev = tail_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  /**
+   * @brief Removes the oldest element. Must only be called by the consumer.
+   *
+   * @return std::optional<T> The element, or nullopt if the queue is empty or
+   * its oldest element is still being pushed.
+   */
+  std::optional<T> pop() {
+    Node *next = head_->next.load(std::memory_order_acquire);
+    if (!next) {
+      return std::nullopt;
+    }
+    /* `next` becomes the new stub; its value moves out. */
+    std::optional<T> value(std::move(*next->value));
+    next->value.reset();
+    delete head_;
+    head_ = next;
+    return value;
+  }
+
+  ~MpscQueue() {
+    while (pop()) {
+    }
+    delete head_;
+  }
+
+private:
+  struct Node {
+    std::atomic<Node *> next = nullptr;
+    std::optional<T> value;
+  };
+
+  /* Not padded apart: the queue is meant to be small enough to embed in many
+   * objects, such as one per actor. */
+  Node *head_;               // Stub node; the consumer's end
+  std::atomic<Node *> tail_; // Newest node; the producers' end
+};
+
+} // namespace internal
+} // namespace async
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__unix__)
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace async {
+
+/**
+ * @brief Scheduling policy of a worker thread.
+ */
+enum class SchedPolicy {
+  /* Keep the policy of the thread that starts the pool. */
+  Inherit,
+  /* The default time-sharing policy. */
+  Other,
+  /* Time-sharing, but treated as CPU-bound: fewer wakeup preemptions. */
+  Batch,
+  /* Runs only when the CPU would otherwise be idle. */
+  Idle,
+  /* Real-time, first in first out; usually needs privileges. */
+  Fifo,
+  /* Real-time with time slices; usually needs privileges. */
+  RoundRobin,
+};
+
+namespace internal {
+
+/**
+ * @brief A joining thread whose stack size can be chosen, which std::thread
+ * does not allow. Uses pthreads where available and std::thread elsewhere,
+ * where the stack size is ignored.
+ */
+class Thread {
+public:
+  Thread() = default;
+
+  /**
+   * @brief Starts a thread that runs `f()`.
+   *
+   * @param stack_size The stack size in bytes; 0 keeps the default. Rounded
+   * up to a whole number of pages, and to at least PTHREAD_STACK_MIN.
+   * @param f The function run by the thread.
+   * @throws std::system_error if the thread cannot be started, e.g. because
+   * its stack cannot be allocated.
+   */
+  template <typename F> Thread(std::size_t stack_size, F &&f) {
+#if defined(__unix__)
+    using Fn = std::decay_t<F>;
+    auto fn = std::make_unique<Fn>(std::forward<F>(f));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (stack_size) {
+      std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+      /* Sizes near SIZE_MAX would wrap around when rounded up; pthread_create
+       * refuses them either way. */
+      stack_size = std::clamp<std::size_t>(stack_size, PTHREAD_STACK_MIN,
+                                           SIZE_MAX / page * page);
+      stack_size = (stack_size + page - 1) / page * page;
+      /* Cannot fail for a page-aligned size of at least PTHREAD_STACK_MIN;
+       * a stack that cannot be allocated makes pthread_create fail. */
+      pthread_attr_setstacksize(&attr, stack_size);
+    }
+    int rc = pthread_create(
+        &handle_, &attr,
+        [](void *arg) -> void * {
+          std::unique_ptr<Fn> fn(static_cast<Fn *>(arg));
+          (*fn)();
+          return nullptr;
+        },
+        fn.get());
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+      throw std::system_error(rc, std::generic_category(),
+                              "pthread_create failed");
+    }
+    fn.release();
+    joinable_ = true;
+#else
+    (void)stack_size;
+    thread_ = std::thread(std::forward<F>(f));
+#endif
+  }
+
+  Thread(Thread &&other) noexcept { *this = std::move(other); }
+
+  Thread &operator=(Thread &&other) noexcept {
+    if (joinable()) {
+      join();
+    }
+#if defined(__unix__)
+    handle_ = other.handle_;
+    joinable_ = std::exchange(other.joinable_, false);
+#else
+    thread_ = std::move(other.thread_);
+#endif
+    return *this;
+  }
+
+  bool joinable() const noexcept {
+#if defined(__unix__)
+    return joinable_;
+#else
+    return thread_.joinable();
+#endif
+  }
+
+  void join() {
+#if defined(__unix__)
+    pthread_join(handle_, nullptr);
+    joinable_ = false;
+#else
+    thread_.join();
+#endif
+  }
+
+  ~Thread() {
+    if (joinable()) {
+      join();
+    }
+  }
+
+private:
+#if defined(__unix__)
+  pthread_t handle_{};
+  bool joinable_ = false;
+#else
+  std::thread thread_;
+#endif
+};
+
+/**
+ * @brief Names the calling thread and sets its scheduling policy and nice
+ * level, as far as the platform and the process's privileges allow. Settings
+ * that cannot be applied are skipped.
+ *
+ * @param name The thread name; truncated to the 15 characters Linux keeps.
+ * @param policy The scheduling policy.
+ * @param priority The real-time priority, for SchedPolicy::Fifo and
+ * SchedPolicy::RoundRobin.
+ * @param nice The nice level; empty keeps the inherited one.
+ */
+inline void configureThread(std::string const &name, SchedPolicy policy,
+                            int priority, std::optional<int> nice) {
+#if defined(__linux__)
+  if (!name.empty()) {
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+  }
+  if (policy != SchedPolicy::Inherit) {
+    int native = SCHED_OTHER;
+    switch (policy) {
+    case SchedPolicy::Batch:
+      native = SCHED_BATCH;
+      break;
+    case SchedPolicy::Idle:
+      native = SCHED_IDLE;
+      break;
+    case SchedPolicy::Fifo:
+      native = SCHED_FIFO;
+      break;
+    case SchedPolicy::RoundRobin:
+      native = SCHED_RR;
+      break;
+    default:
+      break;
+    }
+    sched_param param{};
+    if (native == SCHED_FIFO || native == SCHED_RR) {
+      param.sched_priority = priority;
+    }
+    pthread_setschedparam(pthread_self(), native, &param);
+  }
+  /* On Linux the nice level belongs to the thread, not the process. */
+  if (nice) {
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), *nice);
+  }
+#else
+  (void)name;
+  (void)policy;
+  (void)priority;
+  (void)nice;
+#endif
+}
+
+} // namespace internal
+} // namespace async
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+#include "function2/function2.hpp"
+
+namespace async {
+namespace internal {
+
+/**
+ * @brief A thread that runs callbacks at given times.
+ *
+ * Callbacks run on the timer thread, one after the other, so they should do
+ * no more than hand work to a pool. The thread starts with the first
+ * schedule().
+ */
+class Timer {
+public:
+  using clock = std::chrono::steady_clock;
+  using Callback = fu2::unique_function<void() &&>;
+
+  /**
+   * @brief Identifies a scheduled callback, so that it can be canceled.
+   */
+  struct Handle {
+    clock::time_point when;
+    std::uint64_t id = 0;
+  };
+
+  Timer() = default;
+
+  Timer(Timer const &other) = delete;
+  Timer &operator=(Timer const &other) = delete;
+
+  /**
+   * @brief Runs `callback` on the timer thread at `when`, or soon after.
+   *
+   * @return A handle for cancel().
+   */
+  Handle schedule(clock::time_point when, Callback callback) {
+    std::lock_guard lock(mutex_);
+    if (!thread_.joinable()) {
+      thread_ = std::jthread([this](std::stop_token token) { run(token); });
+    }
+    bool earliest =
+        callbacks_.empty() || when < callbacks_.begin()->first.first;
+    Handle handle{when, ++next_id_};
+    callbacks_.emplace(std::pair(when, handle.id), std::move(callback));
+    if (earliest) {
+      wake_.notify_one();
+    }
+    return handle;
+  }
+
+  /**
+   * @brief Removes a callback that has not started yet, and destroys it.
+   *
+   * @return Whether the callback was removed; false once it has started.
+   */
+  bool cancel(Handle handle) {
+    Callback callback;
+    {
+      std::lock_guard lock(mutex_);
+      auto it = callbacks_.find(std::pair(handle.when, handle.id));
+      if (it == callbacks_.end()) {
+        return false;
+      }
+      callback = std::move(it->second);
+      callbacks_.erase(it);
+    }
+    /* Destroyed outside the lock, as it may own anything. */
+    return true;
+  }
+
+  /**
+   * @brief Returns the timer shared by the whole process.
+   */
+  static Timer &global() {
+    static Timer timer;
+    return timer;
+  }
+
+  /**
+   * @brief Destructor. Stops the thread; callbacks that are not due yet never
+   * run.
+   */
+  ~Timer() {
+    thread_.request_stop();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+private:
+  std::mutex mutex_;                 // Guards callbacks_ and thread_
+  std::condition_variable_any wake_; // Signaled for an earlier deadline
+  /* Ordered by time, then by the order of schedule(). */
+  std::map<std::pair<clock::time_point, std::uint64_t>, Callback> callbacks_;
+  std::uint64_t next_id_ = 0;
+  std::jthread thread_;
+
+  void run(std::stop_token token) {
+    std::unique_lock lock(mutex_);
+    while (!token.stop_requested()) {
+      if (callbacks_.empty()) {
+        wake_.wait(lock, token, [this] { return !callbacks_.empty(); });
+        continue;
+      }
+      auto due = callbacks_.begin();
+      if (clock::now() < due->first.first) {
+        clock::time_point when = due->first.first;
+        wake_.wait_until(lock, token, when, [this, when] {
+          return callbacks_.empty() || callbacks_.begin()->first.first < when;
+        });
+        continue;
+      }
+      Callback callback = std::move(due->second);
+      callbacks_.erase(due);
+      lock.unlock();
+      std::move(callback)();
+      lock.lock();
+    }
+  }
+};
+
+} // namespace internal
+} // namespace async
@@ -1,9 +1,53 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
 
 namespace async {
 namespace internal {
 inline constexpr std::size_t ALIGNMENT = 2 * sizeof(std::max_align_t);
+
+/* Assumed size of a cache line. Used to pad data that is written by different
+ * threads so that it never shares a line. */
+inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * @brief Deleter for arrays allocated by makeCacheAligned().
+ */
+struct CacheAlignedDeleter {
+  void operator()(void *p) const noexcept {
+    ::operator delete[](p, std::align_val_t{CACHE_LINE_SIZE});
+  }
+};
+
+template <typename T>
+using CacheAlignedArray = std::unique_ptr<T[], CacheAlignedDeleter>;
+
+/**
+ * @brief Allocates a zero-initialized array of trivial elements that starts on
+ * a cache line boundary.
+ *
+ * @tparam T The trivial element type.
+ * @param n The number of elements.
+ * @return CacheAlignedArray<T> The owning pointer to the array.
+ */
+template <typename T> CacheAlignedArray<T> makeCacheAligned(std::size_t n) {
+  static_assert(std::is_trivial_v<T>);
+  void *p = ::operator new[](n * sizeof(T), std::align_val_t{CACHE_LINE_SIZE});
+  std::uninitialized_value_construct_n(static_cast<T *>(p), n);
+  return CacheAlignedArray<T>(static_cast<T *>(p));
+}
+
+/**
+ * @brief Rounds a count of elements of type T up so that the elements fill a
+ * whole number of cache lines.
+ */
+template <typename T>
+constexpr std::size_t roundUpToCacheLine(std::size_t n) noexcept {
+  constexpr std::size_t per_line = CACHE_LINE_SIZE / sizeof(T);
+  return (n + per_line - 1) / per_line * per_line;
 }
-} // namespace async
\ No newline at end of file
+} // namespace internal
+} // namespace async
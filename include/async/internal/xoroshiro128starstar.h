@@ -28,9 +28,10 @@ static inline uint64_t rotl(const uint64_t x, int k) {
   return (x << k) | (x >> (64 - k));
 }
 
-static uint64_t s[2] = {11, 29}; // Random seed value
+/* Each thread has its own state, so threads never race on it. */
+inline thread_local uint64_t s[2] = {11, 29}; // Random seed value
 
-uint64_t next(void) {
+inline uint64_t next(void) {
   const uint64_t s0 = s[0];
   uint64_t s1 = s[1];
   const uint64_t result = rotl(s0 * 5, 7) * 9;
@@ -42,11 +43,24 @@ uint64_t next(void) {
   return result;
 }
 
+/* Seeds the calling thread's state from a 64-bit value by running it through
+   splitmix64, as suggested above. Much cheaper than jump() for giving each
+   thread a different sequence. */
+
+inline void seed(uint64_t x) {
+  for (uint64_t &word : s) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    word = z ^ (z >> 31);
+  }
+}
+
 /* This is the jump function for the generator. It is equivalent
    to 2^64 calls to next(); it can be used to generate 2^64
    non-overlapping subsequences for parallel computations. */
 
-void jump(void) {
+inline void jump(void) {
   static const uint64_t JUMP[] = {0xdf900294d8f554a5, 0x170865df4b3201fc};
 
   uint64_t s0 = 0;
@@ -69,7 +83,7 @@ void jump(void) {
    from each of which jump() will generate 2^32 non-overlapping
    subsequences for parallel distributed computations. */
 
-void long_jump(void) {
+inline void long_jump(void) {
   static const uint64_t LONG_JUMP[] = {0xd2a98b26625eee7b, 0xdddf9b1090aa7ac1};
 
   uint64_t s0 = 0;
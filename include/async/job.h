@@ -0,0 +1,401 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include <async/threadpool.h>
+
+namespace async {
+
+template <typename T = void> class Job;
+
+namespace internal {
+
+/* Added to a frame's join counter while the frame is suspended in join(), so
+ * that the last child to finish can tell that it has to resume the frame. */
+inline constexpr std::int64_t JOIN_WAITING = std::int64_t{1} << 32;
+
+/**
+ * @brief Gives the job machinery access to the continuation deques of
+ * ThreadPool.
+ */
+struct JobAccess {
+  static void pushContinuation(ThreadPool &pool, std::coroutine_handle<> h) {
+    pool.pushContinuation(h);
+  }
+
+  static bool popContinuation(ThreadPool &pool, std::coroutine_handle<> h) {
+    return pool.popContinuation(h);
+  }
+
+  template <typename Predicate>
+  static void waitUntil(ThreadPool &pool, Predicate &&done) {
+    pool.waitUntil(std::forward<Predicate>(done));
+  }
+};
+
+/* Tag returned by join(). */
+struct JoinTag {};
+
+/**
+ * @brief The part of a job's promise that does not depend on its result type.
+ */
+struct JobPromiseBase {
+  /* For a called (not forked) job: the caller, and whether either the job has
+   * finished or the caller has suspended. Whichever of the two comes second
+   * resumes the caller. */
+  std::coroutine_handle<> continuation;
+  std::atomic<bool> handoff = false;
+
+  /* For a forked job: the frame that forked it, and the pool whose
+   * continuation deque holds the parent's continuation (nullptr if it was not
+   * pushed because the fork happened outside a pool). */
+  JobPromiseBase *parent = nullptr;
+  std::coroutine_handle<> parent_handle;
+  ThreadPool *pool = nullptr;
+  std::uint64_t fork_number = 0; // The parent's forks after this one's fork
+
+  /* Number of fork() calls made by this frame. Written only by the thread
+   * running the frame; a child compares it to its fork_number to tell its own
+   * continuation from one the frame pushed by forking again. */
+  std::atomic<std::uint64_t> forks = 0;
+
+  /* For a forked job: set when it finishes before fork() returns and the
+   * parent's continuation was not stolen. Points into the forking thread's
+   * stack, so it is only valid in that case. */
+  bool *finished_inline = nullptr;
+
+  /* For the root job started by run(): set when it finishes. */
+  std::atomic<bool> *done = nullptr;
+
+  /* Forked children that have not finished, plus JOIN_WAITING while this
+   * frame waits for them in join(). */
+  std::atomic<std::int64_t> joins = 0;
+
+  std::exception_ptr exception;       // Exception that ended this job
+  std::atomic_flag child_failed;      // Set by the first failing child
+  std::exception_ptr child_exception; // Exception of the first failing child
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+  /**
+   * @brief Decides what runs after a job finishes.
+   */
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> h) noexcept {
+      JobPromiseBase &self = h.promise();
+      assert(self.joins.load(std::memory_order_relaxed) == 0 &&
+             "Job finished without joining its forked children");
+
+      if (!self.parent) {
+        if (self.done) {
+          /* Root job; run() may destroy the frame as soon as it sees this. */
+          self.done->store(true, std::memory_order_release);
+          return std::noop_coroutine();
+        }
+        if (self.handoff.exchange(true, std::memory_order_acq_rel)) {
+          return self.continuation;
+        }
+        return std::noop_coroutine();
+      }
+
+      /* Forked jobs own their frame. */
+      JobPromiseBase *parent = self.parent;
+      std::coroutine_handle<> parent_handle = self.parent_handle;
+      ThreadPool *pool = self.pool;
+      std::uint64_t fork_number = self.fork_number;
+      bool *finished_inline = self.finished_inline;
+      if (self.exception &&
+          !parent->child_failed.test_and_set(std::memory_order_relaxed)) {
+        parent->child_exception = self.exception;
+      }
+      h.destroy();
+
+      /* A parent that has forked again since was resumed, so its entry for
+       * this fork is gone, and the newest entry of the same frame belongs to
+       * a later fork. That fork happened on this thread if it pushed to this
+       * thread's deque, so the count read here is up to date. */
+      if (!pool ||
+          (parent->forks.load(std::memory_order_relaxed) == fork_number &&
+           JobAccess::popContinuation(*pool, parent_handle))) {
+        /* The parent's continuation was not stolen, so this job finished
+         * inside fork(), which now carries on with the parent exactly as a
+         * sequential call would. */
+        parent->joins.fetch_sub(1, std::memory_order_relaxed);
+        *finished_inline = true;
+        return std::noop_coroutine();
+      }
+      /* The continuation was stolen. Resume the parent only if it is waiting
+       * in join() and this was its last child. */
+      if (parent->joins.fetch_sub(1, std::memory_order_acq_rel) ==
+          JOIN_WAITING + 1) {
+        return parent_handle;
+      }
+      return std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  FinalAwaiter final_suspend() noexcept { return {}; }
+
+  /**
+   * @brief Suspends until every job forked by this frame has finished.
+   */
+  struct JoinAwaiter {
+    JobPromiseBase &self;
+
+    bool await_ready() noexcept {
+      return self.joins.load(std::memory_order_acquire) == 0;
+    }
+
+    bool await_suspend(std::coroutine_handle<>) noexcept {
+      if (self.joins.fetch_add(JOIN_WAITING, std::memory_order_acq_rel) ==
+          0) {
+        /* All children finished in the meantime. */
+        self.joins.store(0, std::memory_order_relaxed);
+        return false;
+      }
+      return true;
+    }
+
+    void await_resume() {
+      self.joins.store(0, std::memory_order_relaxed);
+      if (self.child_exception) {
+        self.child_failed.clear(std::memory_order_relaxed);
+        std::rethrow_exception(std::exchange(self.child_exception, nullptr));
+      }
+    }
+  };
+
+  JoinAwaiter await_transform(JoinTag) noexcept { return {*this}; }
+
+  template <typename Awaitable>
+  Awaitable &&await_transform(Awaitable &&awaitable) noexcept {
+    return std::forward<Awaitable>(awaitable);
+  }
+};
+
+/**
+ * @brief Promise of a job that produces a value of type T.
+ */
+template <typename T> struct JobPromise : JobPromiseBase {
+  T *slot = nullptr; // Where a forked job stores its result
+  std::optional<T> value;
+
+  Job<T> get_return_object() noexcept;
+
+  template <typename U> void return_value(U &&v) {
+    if (slot) {
+      *slot = std::forward<U>(v);
+    } else {
+      value.emplace(std::forward<U>(v));
+    }
+  }
+
+  T result() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+    return std::move(*value);
+  }
+};
+
+template <> struct JobPromise<void> : JobPromiseBase {
+  Job<void> get_return_object() noexcept;
+
+  void return_void() noexcept {}
+
+  void result() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+};
+
+/**
+ * @brief Awaiter of fork(): runs the child right away and leaves the rest of
+ * the parent to be stolen.
+ *
+ * The child is resumed with an ordinary call rather than by symmetric transfer
+ * so that a loop of forks does not depend on tail calls (which debug and
+ * sanitizer builds do not make) to run in constant stack space.
+ */
+template <typename T> struct ForkAwaiter {
+  std::coroutine_handle<JobPromise<T>> child;
+
+  bool await_ready() noexcept { return false; }
+
+  template <typename Promise>
+  bool await_suspend(std::coroutine_handle<Promise> parent) noexcept {
+    static_assert(std::is_base_of_v<JobPromiseBase, Promise>,
+                  "fork() can only be awaited inside a Job");
+    JobPromise<T> &promise = child.promise();
+    promise.parent = &parent.promise();
+    promise.parent_handle = parent;
+    promise.pool = ThreadPool::current();
+    promise.fork_number =
+        parent.promise().forks.fetch_add(1, std::memory_order_relaxed) + 1;
+    bool finished_inline = false;
+    promise.finished_inline = &finished_inline;
+    parent.promise().joins.fetch_add(1, std::memory_order_relaxed);
+
+    /* Once the continuation is pushed the parent may be resumed by a thief,
+     * so only locals may be used from here on. */
+    std::coroutine_handle<> next = child;
+    if (ThreadPool *pool = promise.pool) {
+      JobAccess::pushContinuation(*pool, parent);
+    }
+    next.resume();
+    return !finished_inline;
+  }
+
+  void await_resume() noexcept {}
+};
+
+/**
+ * @brief Awaiter of `co_await job`: an ordinary call that resumes the caller
+ * once the job finishes.
+ */
+template <typename T> struct CallAwaiter {
+  std::coroutine_handle<JobPromise<T>> child;
+
+  bool await_ready() noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<> caller) {
+    child.promise().continuation = caller;
+    child.resume();
+    /* Carry on right away if the job has already finished. */
+    return !child.promise().handoff.exchange(true, std::memory_order_acq_rel);
+  }
+
+  T await_resume() { return child.promise().result(); }
+};
+
+} // namespace internal
+
+/**
+ * @brief A coroutine that runs on a ThreadPool with work-first (continuation
+ * stealing) semantics.
+ *
+ * Inside a job, `co_await fork(result, child())` starts `child()` immediately
+ * on the current worker and makes the rest of the calling job available for
+ * other workers to steal, as in Cilk. `co_await join()` waits for all jobs the
+ * caller forked, and must be reached before the caller returns if it forked
+ * anything. `co_await child()` calls a job like a function.
+ *
+ * Because a worker always runs the newest child and only the continuation is
+ * queued, each worker's deque holds at most one entry per suspended ancestor,
+ * so a loop that forks N children needs O(1) queued entries instead of O(N),
+ * and space is bounded by the recursion depth.
+ *
+ * @tparam T The type of the result.
+ */
+template <typename T> class [[nodiscard]] Job {
+public:
+  using promise_type = internal::JobPromise<T>;
+
+  Job(Job &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Job &operator=(Job &&other) = delete;
+
+  ~Job() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  /**
+   * @brief Calls the job: the awaiting job continues once this one finishes.
+   */
+  internal::CallAwaiter<T> operator co_await() && noexcept {
+    return {handle_};
+  }
+
+private:
+  friend promise_type;
+  template <typename U>
+  friend internal::ForkAwaiter<U> fork(U &slot, Job<U> job);
+  friend internal::ForkAwaiter<void> fork(Job<void> job);
+  template <typename U> friend U run(ThreadPool &pool, Job<U> job);
+
+  explicit Job(std::coroutine_handle<promise_type> handle) noexcept
+      : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace internal {
+
+template <typename T> Job<T> JobPromise<T>::get_return_object() noexcept {
+  return Job<T>(std::coroutine_handle<JobPromise<T>>::from_promise(*this));
+}
+
+inline Job<void> JobPromise<void>::get_return_object() noexcept {
+  return Job<void>(std::coroutine_handle<JobPromise<void>>::from_promise(*this));
+}
+
+} // namespace internal
+
+/**
+ * @brief Forks `job` from the awaiting job, storing its result in `slot`.
+ *
+ * The child runs immediately on the current worker; the rest of the awaiting
+ * job may be stolen meanwhile. `slot` must stay valid until join().
+ *
+ * @param slot Where the result of the child is stored; of the job's result
+ * type.
+ * @param job The child job.
+ */
+template <typename T> internal::ForkAwaiter<T> fork(T &slot, Job<T> job) {
+  auto child = std::exchange(job.handle_, {});
+  child.promise().slot = &slot;
+  return {child};
+}
+
+/**
+ * @brief Forks a job without a result from the awaiting job.
+ *
+ * @param job The child job.
+ */
+inline internal::ForkAwaiter<void> fork(Job<void> job) {
+  return {std::exchange(job.handle_, {})};
+}
+
+/**
+ * @brief Returns an awaitable that waits until every job forked by the
+ * awaiting job has finished, and rethrows the first exception thrown by one of
+ * them.
+ */
+inline internal::JoinTag join() noexcept { return {}; }
+
+/**
+ * @brief Runs `job` on `pool` and waits for its result.
+ *
+ * The calling thread runs pending tasks of the pool while it waits.
+ *
+ * @param pool The pool that runs the job and everything it forks.
+ * @param job The root job.
+ * @return T The result of the job.
+ */
+template <typename T> T run(ThreadPool &pool, Job<T> job) {
+  std::atomic<bool> done = false;
+  job.handle_.promise().done = &done;
+  pool.spawn([h = job.handle_] { h.resume(); });
+  internal::JobAccess::waitUntil(
+      pool, [&done] { return done.load(std::memory_order_acquire); });
+  return job.handle_.promise().result();
+}
+
+} // namespace async
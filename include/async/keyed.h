@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <async/strand.h>
+#include <async/threadpool.h>
+
+namespace async {
+
+namespace internal {
+
+/* Partitions created per worker when the count is picked automatically. Many
+ * more partitions than workers keep unrelated keys from queueing behind each
+ * other. */
+inline constexpr std::size_t KEYED_PARTITIONS_PER_WORKER = 16;
+
+/* Number of candidate hot keys tracked per partition. */
+inline constexpr std::size_t HOT_KEY_SLOTS = 8;
+
+/**
+ * @brief Scrambles a hash so that keys with regular hashes, such as small
+ * integers under std::hash, still spread over the partitions.
+ */
+inline std::size_t mixHash(std::size_t h) noexcept {
+  std::uint64_t z = static_cast<std::uint64_t>(h) + 0x9e3779b97f4a7c15;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return static_cast<std::size_t>(z ^ (z >> 31));
+}
+
+} // namespace internal
+
+/**
+ * @brief Runs tasks in FIFO order per key, and in parallel across keys.
+ *
+ * Each key is hashed to one of many partitions, and each partition is a Strand
+ * on the pool. Tasks for the same key therefore run one at a time in the order
+ * in which they were submitted, while tasks for keys in different partitions
+ * run on any worker. No thread is dedicated to a partition; an idle partition
+ * costs only its empty queue.
+ *
+ * Every partition also counts its tasks and tracks its most frequent keys with
+ * the Space-Saving algorithm, so that skew concentrating load on a few keys
+ * shows up in stats().
+ *
+ * @tparam Key The type of the keys. Must be copyable and equality comparable.
+ * @tparam Hash The hash function for keys.
+ */
+template <typename Key, typename Hash = std::hash<Key>> class KeyedExecutor {
+public:
+  /**
+   * @brief Constructs an executor whose partitions run on `pool`.
+   *
+   * @param pool The thread pool on which the tasks run.
+   * @param partitions The number of partitions. 0 picks
+   * KEYED_PARTITIONS_PER_WORKER per worker of the pool.
+   */
+  explicit KeyedExecutor(ThreadPool &pool, std::size_t partitions = 0)
+      : pool_(pool) {
+    if (partitions == 0) {
+      partitions = pool.size() * internal::KEYED_PARTITIONS_PER_WORKER;
+    }
+    for (std::size_t i = 0; i < partitions; ++i) {
+      partitions_.emplace_back(pool);
+    }
+  }
+
+  /**
+   * @brief Constructs an executor whose partitions run on this_pool().
+   */
+  KeyedExecutor() : KeyedExecutor(this_pool()) {}
+
+  /**
+   * @brief Submits a task that runs after all tasks previously submitted with
+   * the same key.
+   *
+   * @param key The key whose order the task joins.
+   * @param f The task function to be executed.
+   * @param args The arguments to be passed to the task function.
+   * @return The future object associated with the task result.
+   */
+  template <typename... Args, typename F>
+  std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+  submit_keyed(Key const &key, F &&f, Args &&... args) {
+    Partition &p = partitions_[partition_of(key)];
+    std::uint64_t backlog =
+        p.backlog.fetch_add(1, std::memory_order_relaxed) + 1;
+    std::uint64_t peak = p.peak_backlog.load(std::memory_order_relaxed);
+    while (backlog > peak && !p.peak_backlog.compare_exchange_weak(
+                                 peak, backlog, std::memory_order_relaxed)) {
+    }
+    auto call = internal::bindFunctionToArguments(std::forward<F>(f),
+                                                  std::forward<Args>(args)...);
+    return p.strand.submit([&p, key, call = std::move(call)]() mutable {
+      /* Runs serially within the partition, so its counters need no
+       * synchronization. */
+      p.backlog.fetch_sub(1, std::memory_order_relaxed);
+      p.count(key);
+      return call();
+    });
+  }
+
+  /**
+   * @brief Returns the number of partitions.
+   */
+  std::size_t partitions() const noexcept { return partitions_.size(); }
+
+  /**
+   * @brief Returns the partition that runs the tasks of `key`.
+   */
+  std::size_t partition_of(Key const &key) const {
+    return internal::mixHash(Hash{}(key)) % partitions_.size();
+  }
+
+  /**
+   * @brief A key that received a large share of the tasks.
+   */
+  struct HotKey {
+    Key key;
+    std::uint64_t count;   // Tasks run for the key; may overestimate
+    std::size_t partition; // Partition of the key
+  };
+
+  /**
+   * @brief Load statistics of the partitions.
+   */
+  struct Stats {
+    std::vector<std::uint64_t> tasks;        // Tasks run per partition
+    std::vector<std::uint64_t> peak_backlog; // Most tasks queued at once
+    std::vector<HotKey> hot_keys;            // Most frequent keys first
+    double imbalance; // Tasks of the busiest partition over the mean
+  };
+
+  /**
+   * @brief Collects the statistics of all partitions.
+   *
+   * The counters of each partition are read by a task on that partition, so
+   * the snapshot of a partition includes every task submitted to it before
+   * the call. Blocks until those tasks have run.
+   *
+   * @param top The number of hot keys to report.
+   */
+  Stats stats(std::size_t top = internal::HOT_KEY_SLOTS) {
+    using Snapshot = std::pair<std::uint64_t, std::vector<HotKey>>;
+    std::vector<std::future<Snapshot>> futures;
+    for (std::size_t i = 0; i < partitions_.size(); ++i) {
+      Partition &p = partitions_[i];
+      futures.push_back(p.strand.submit([&p, i] {
+        std::vector<HotKey> keys;
+        for (auto const &[key, count] : p.hot) {
+          keys.push_back({key, count, i});
+        }
+        return Snapshot(p.tasks, std::move(keys));
+      }));
+    }
+
+    Stats stats;
+    std::uint64_t total = 0, busiest = 0;
+    for (std::size_t i = 0; i < futures.size(); ++i) {
+      pool_.wait(futures[i]);
+      auto [tasks, keys] = futures[i].get();
+      stats.tasks.push_back(tasks);
+      stats.peak_backlog.push_back(
+          partitions_[i].peak_backlog.load(std::memory_order_relaxed));
+      stats.hot_keys.insert(stats.hot_keys.end(), keys.begin(), keys.end());
+      total += tasks;
+      busiest = std::max(busiest, tasks);
+    }
+    std::sort(
+        stats.hot_keys.begin(), stats.hot_keys.end(),
+        [](HotKey const &a, HotKey const &b) { return a.count > b.count; });
+    if (stats.hot_keys.size() > top) {
+      stats.hot_keys.erase(stats.hot_keys.begin() + top, stats.hot_keys.end());
+    }
+    stats.imbalance = total ? static_cast<double>(busiest) *
+                                  partitions_.size() / total
+                            : 0.0;
+    return stats;
+  }
+
+private:
+  /**
+   * @brief A serial queue with its load counters.
+   */
+  struct Partition {
+    explicit Partition(ThreadPool &pool) : strand(pool) {}
+
+    /* Updated by the partition's own tasks only. */
+    std::uint64_t tasks = 0;
+    std::vector<std::pair<Key, std::uint64_t>> hot; // Candidate hot keys
+
+    /* Updated by submitters. */
+    std::atomic<std::uint64_t> backlog = 0;
+    std::atomic<std::uint64_t> peak_backlog = 0;
+
+    Strand strand; // Destroyed first, so that queued tasks still see counters
+
+    /**
+     * @brief Counts a task for `key` with Space-Saving: a key without a slot
+     * takes over the slot with the lowest count, plus one.
+     */
+    void count(Key const &key) {
+      ++tasks;
+      for (auto &[candidate, count] : hot) {
+        if (candidate == key) {
+          ++count;
+          return;
+        }
+      }
+      if (hot.size() < internal::HOT_KEY_SLOTS) {
+        hot.emplace_back(key, 1);
+        return;
+      }
+      auto min = std::min_element(
+          hot.begin(), hot.end(),
+          [](auto const &a, auto const &b) { return a.second < b.second; });
+      *min = {key, min->second + 1};
+    }
+  };
+
+  ThreadPool &pool_;                 // Pool on which the tasks run
+  std::deque<Partition> partitions_; // Serial queues; not movable
+};
+
+} // namespace async
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include <async/threadpool.h>
+
+namespace async {
+
+namespace internal {
+
+/* Side of the square tile below which transpose stops forking. A tile of
+ * doubles is 32 KiB, so the source and destination tiles fit in L1/L2. */
+inline constexpr std::size_t TRANSPOSE_LEAF = 64;
+
+/* Side of the micro tile copied at once by the transpose leaf kernel. */
+inline constexpr std::size_t TRANSPOSE_MICRO = 8;
+
+/* Dimension below which gemm stops forking. Three 64x64 blocks of doubles
+ * take 96 KiB and stay in L2 while the leaf kernel runs. */
+inline constexpr std::size_t GEMM_LEAF = 64;
+
+/**
+ * @brief Transposes a leaf tile: b[j][i] = a[i][j].
+ *
+ * The tile is processed in square micro tiles so that both the rows read from
+ * `a` and the rows written to `b` stay in cache. The inner loops have constant
+ * trip counts and contiguous reads, which lets the compiler vectorize them.
+ */
+template <typename T>
+void transposeLeaf(std::size_t rows, std::size_t cols, T const *a,
+                   std::size_t lda, T *b, std::size_t ldb) {
+  for (std::size_t i0 = 0; i0 < rows; i0 += TRANSPOSE_MICRO) {
+    std::size_t i1 = std::min(rows, i0 + TRANSPOSE_MICRO);
+    for (std::size_t j0 = 0; j0 < cols; j0 += TRANSPOSE_MICRO) {
+      std::size_t j1 = std::min(cols, j0 + TRANSPOSE_MICRO);
+      for (std::size_t j = j0; j < j1; ++j) {
+        for (std::size_t i = i0; i < i1; ++i) {
+          b[j * ldb + i] = a[i * lda + j];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Recursively halves the longer side of the matrix and transposes the
+ * halves in parallel.
+ */
+template <typename T>
+void transposeRecursive(ThreadPool &pool, std::size_t rows, std::size_t cols,
+                        T const *a, std::size_t lda, T *b, std::size_t ldb) {
+  if (rows <= TRANSPOSE_LEAF && cols <= TRANSPOSE_LEAF) {
+    transposeLeaf(rows, cols, a, lda, b, ldb);
+    return;
+  }
+  TaskGroup group(pool);
+  if (rows >= cols) {
+    std::size_t half = rows / 2;
+    group.run([=, &pool] {
+      transposeRecursive(pool, half, cols, a, lda, b, ldb);
+    });
+    transposeRecursive(pool, rows - half, cols, a + half * lda, lda, b + half,
+                       ldb);
+  } else {
+    std::size_t half = cols / 2;
+    group.run([=, &pool] {
+      transposeRecursive(pool, rows, half, a, lda, b, ldb);
+    });
+    transposeRecursive(pool, rows, cols - half, a + half, lda, b + half * ldb,
+                       ldb);
+  }
+  group.wait();
+}
+
+/**
+ * @brief Computes c += a * b for a leaf block.
+ *
+ * Four rows of `c` are updated together so that each row of `b` loaded into
+ * registers is used four times. The innermost loop runs along contiguous rows
+ * of `b` and `c`, which the compiler turns into SIMD multiply-adds.
+ */
+template <typename T>
+void gemmLeaf(std::size_t m, std::size_t n, std::size_t k, T const *a,
+              std::size_t lda, T const *b, std::size_t ldb, T *c,
+              std::size_t ldc) {
+  std::size_t i = 0;
+  for (; i + 4 <= m; i += 4) {
+    T *c0 = c + i * ldc;
+    T *c1 = c0 + ldc;
+    T *c2 = c1 + ldc;
+    T *c3 = c2 + ldc;
+    for (std::size_t p = 0; p < k; ++p) {
+      T a0 = a[i * lda + p];
+      T a1 = a[(i + 1) * lda + p];
+      T a2 = a[(i + 2) * lda + p];
+      T a3 = a[(i + 3) * lda + p];
+      T const *bp = b + p * ldb;
+      for (std::size_t j = 0; j < n; ++j) {
+        T bv = bp[j];
+        c0[j] += a0 * bv;
+        c1[j] += a1 * bv;
+        c2[j] += a2 * bv;
+        c3[j] += a3 * bv;
+      }
+    }
+  }
+  for (; i < m; ++i) {
+    T *ci = c + i * ldc;
+    for (std::size_t p = 0; p < k; ++p) {
+      T ai = a[i * lda + p];
+      T const *bp = b + p * ldb;
+      for (std::size_t j = 0; j < n; ++j) {
+        ci[j] += ai * bp[j];
+      }
+    }
+  }
+}
+
+/**
+ * @brief Cache-oblivious recursive gemm.
+ *
+ * The largest of the three dimensions is halved at each level. Halving m or n
+ * produces two independent updates of disjoint parts of `c`, which are forked.
+ * Halving k produces two updates of the same block of `c`, which run one after
+ * the other.
+ */
+template <typename T>
+void gemmRecursive(ThreadPool &pool, std::size_t m, std::size_t n,
+                   std::size_t k, T const *a, std::size_t lda, T const *b,
+                   std::size_t ldb, T *c, std::size_t ldc) {
+  if (m <= GEMM_LEAF && n <= GEMM_LEAF && k <= GEMM_LEAF) {
+    gemmLeaf(m, n, k, a, lda, b, ldb, c, ldc);
+    return;
+  }
+  if (k >= m && k >= n) {
+    std::size_t half = k / 2;
+    gemmRecursive(pool, m, n, half, a, lda, b, ldb, c, ldc);
+    gemmRecursive(pool, m, n, k - half, a + half, lda, b + half * ldb, ldb, c,
+                  ldc);
+    return;
+  }
+  TaskGroup group(pool);
+  if (m >= n) {
+    std::size_t half = m / 2;
+    group.run([=, &pool] {
+      gemmRecursive(pool, half, n, k, a, lda, b, ldb, c, ldc);
+    });
+    gemmRecursive(pool, m - half, n, k, a + half * lda, lda, b, ldb,
+                  c + half * ldc, ldc);
+  } else {
+    std::size_t half = n / 2;
+    group.run([=, &pool] {
+      gemmRecursive(pool, m, half, k, a, lda, b, ldb, c, ldc);
+    });
+    gemmRecursive(pool, m, n - half, k, a, lda, b + half, ldb, c + half, ldc);
+  }
+  group.wait();
+}
+
+} // namespace internal
+
+/**
+ * @brief Transposes a row-major `rows` x `cols` matrix in parallel:
+ * b[j * ldb + i] = a[i * lda + j].
+ *
+ * The matrix is split recursively into halves that are transposed as forked
+ * tasks, down to tiles that fit in cache.
+ *
+ * @param pool The thread pool that runs the tasks.
+ * @param rows The number of rows of `a`.
+ * @param cols The number of columns of `a`.
+ * @param a The source matrix.
+ * @param lda The distance between consecutive rows of `a`.
+ * @param b The destination matrix. Must not overlap `a`.
+ * @param ldb The distance between consecutive rows of `b`.
+ */
+template <typename T>
+void parallel_transpose(ThreadPool &pool, std::size_t rows, std::size_t cols,
+                        T const *a, std::size_t lda, T *b, std::size_t ldb) {
+  if (rows == 0 || cols == 0) {
+    return;
+  }
+  TaskGroup group(pool);
+  group.run([&] {
+    internal::transposeRecursive(pool, rows, cols, a, lda, b, ldb);
+  });
+  group.wait();
+}
+
+/**
+ * @brief Computes c += a * b in parallel for row-major matrices, where `a` is
+ * m x k, `b` is k x n and `c` is m x n.
+ *
+ * This is a reference kernel meant to exercise the scheduler on compute-bound
+ * recursive work, not a replacement for a tuned BLAS.
+ *
+ * @param pool The thread pool that runs the tasks.
+ * @param m The number of rows of `a` and `c`.
+ * @param n The number of columns of `b` and `c`.
+ * @param k The number of columns of `a` and rows of `b`.
+ * @param a The left operand.
+ * @param lda The distance between consecutive rows of `a`.
+ * @param b The right operand.
+ * @param ldb The distance between consecutive rows of `b`.
+ * @param c The accumulator. Must not overlap `a` or `b`.
+ * @param ldc The distance between consecutive rows of `c`.
+ */
+template <typename T>
+void parallel_gemm(ThreadPool &pool, std::size_t m, std::size_t n,
+                   std::size_t k, T const *a, std::size_t lda, T const *b,
+                   std::size_t ldb, T *c, std::size_t ldc) {
+  if (m == 0 || n == 0 || k == 0) {
+    return;
+  }
+  TaskGroup group(pool);
+  group.run([&] {
+    internal::gemmRecursive(pool, m, n, k, a, lda, b, ldb, c, ldc);
+  });
+  group.wait();
+}
+
+} // namespace async
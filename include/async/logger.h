@@ -0,0 +1,443 @@
+#pragma once
+
+#if defined(__unix__)
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <async/mutex.h>
+#include <async/threadpool.h>
+
+namespace async {
+
+/**
+ * @brief A type that Logger::log() can take as an argument: copied as raw
+ * bytes on the hot path and formatted later.
+ */
+template <typename T>
+concept Loggable =
+    std::is_arithmetic_v<T> || std::is_same_v<T, char const *> ||
+    std::is_same_v<T, char *> || std::is_same_v<T, void const *> ||
+    std::is_same_v<T, void *>;
+
+namespace internal {
+
+/* Bytes of arguments a log record can hold. */
+inline constexpr std::size_t LOG_ARGS_BYTES = 40;
+
+/* Most records written with one writev() call. */
+inline constexpr std::size_t LOG_IOV_MAX = IOV_MAX < 1024 ? IOV_MAX : 1024;
+
+/**
+ * @brief A log record as written on the hot path: unformatted, with its
+ * arguments copied as raw bytes. Fills one cache line.
+ */
+struct alignas(64) LogRecord {
+  std::int64_t time; // steady_clock ticks
+  char const *format;
+  void (*render)(std::string &out, char const *format,
+                 std::byte const *args);
+  std::byte args[LOG_ARGS_BYTES];
+};
+
+static_assert(sizeof(LogRecord) == 64);
+
+/**
+ * @brief A bounded ring of log records with one producer and one consumer.
+ *
+ * The producer and consumer indices live on cache lines of their own, and
+ * each side caches the other's index, so a push touches shared state only
+ * when the cached index says the ring may be full.
+ */
+class LogRing {
+public:
+  explicit LogRing(std::size_t capacity)
+      : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+        records_(std::make_unique<LogRecord[]>(mask_ + 1)) {}
+
+  /**
+   * @brief Returns the slot for the next record, or nullptr if the ring is
+   * full. Producer only.
+   */
+  LogRecord *reserve() noexcept {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) {
+        return nullptr;
+      }
+    }
+    return &records_[tail & mask_];
+  }
+
+  /**
+   * @brief Publishes the record filled in after reserve(). Producer only.
+   */
+  void commit() noexcept {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  /**
+   * @brief Copies the published records to `out` and frees their slots.
+   * Consumer only.
+   */
+  void drainTo(std::vector<std::pair<LogRecord, std::size_t>> &out,
+               std::size_t source) {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    std::size_t tail = tail_.load(std::memory_order_acquire);
+    for (; head != tail; ++head) {
+      out.emplace_back(records_[head & mask_], source);
+    }
+    head_.store(head, std::memory_order_release);
+  }
+
+private:
+  std::size_t const mask_;
+  std::unique_ptr<LogRecord[]> records_;
+  alignas(64) std::atomic<std::size_t> tail_ = 0; // Producer's end
+  std::size_t head_cache_ = 0;                     // Producer's view of head_
+  alignas(64) std::atomic<std::size_t> head_ = 0; // Consumer's end
+};
+
+inline void appendArg(std::string &out, bool value) {
+  out += value ? "true" : "false";
+}
+
+inline void appendArg(std::string &out, char value) { out += value; }
+
+inline void appendArg(std::string &out, char const *value) {
+  out += value ? value : "(null)";
+}
+
+inline void appendArg(std::string &out, void const *value) {
+  char buffer[2 + 2 * sizeof(void *)] = {'0', 'x'};
+  auto result = std::to_chars(buffer + 2, buffer + sizeof buffer,
+                              reinterpret_cast<std::uintptr_t>(value), 16);
+  out.append(buffer, result.ptr);
+}
+
+template <typename T>
+  requires std::is_arithmetic_v<T>
+void appendArg(std::string &out, T value) {
+  char buffer[64];
+  auto result = std::to_chars(buffer, buffer + sizeof buffer, value);
+  out.append(buffer, result.ptr);
+}
+
+/**
+ * @brief Formats a record whose arguments have the types `Args`, replacing
+ * each `{}` in the format with the next argument. A `{}` left without an
+ * argument is kept as it is.
+ */
+template <typename... Args>
+void renderRecord(std::string &out, char const *format,
+                  std::byte const *args) {
+  std::string_view rest(format);
+  std::size_t offset = 0;
+  [[maybe_unused]] auto next = [&]<typename T>() {
+    std::size_t brace = rest.find("{}");
+    out.append(rest.substr(0, brace));
+    if (brace == std::string_view::npos) {
+      rest = {};
+      return;
+    }
+    rest.remove_prefix(brace + 2);
+    T value;
+    std::memcpy(&value, args + offset, sizeof(T));
+    offset += sizeof(T);
+    if constexpr (std::is_pointer_v<T> &&
+                  !std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>,
+                                  char>) {
+      appendArg(out, static_cast<void const *>(value));
+    } else if constexpr (std::is_pointer_v<T>) {
+      appendArg(out, static_cast<char const *>(value));
+    } else {
+      appendArg(out, value);
+    }
+  };
+  (next.template operator()<Args>(), ...);
+  out.append(rest);
+}
+
+} // namespace internal
+
+/**
+ * @brief Settings of a Logger.
+ */
+struct LoggerOptions {
+  /* Records each ring holds; rounded up to a power of two. */
+  std::size_t ring_records = 4096;
+  /* How often the background thread collects and writes records. */
+  std::chrono::milliseconds interval{1};
+};
+
+/**
+ * @brief An asynchronous logger whose hot path neither formats, allocates nor
+ * takes a lock.
+ *
+ * Every worker of the pool writes its records into a ring of its own: a
+ * timestamp, the format string pointer, a formatting function and the raw
+ * bytes of the arguments, in a single cache line. A background thread
+ * collects the records of all rings every `interval`, merges them by
+ * timestamp, formats them and writes them with writev(). Threads outside the
+ * pool share one more ring, guarded by a lock.
+ *
+ * When a ring is full the record is dropped rather than making the task
+ * wait; dropped() counts them. Records are ordered by time within each
+ * collection; a record that a worker publishes late may follow newer ones
+ * collected just before it.
+ *
+ * @note The format string and every `char const *` argument must stay valid
+ * until the record is written, as only the pointers are copied; string
+ * literals are the intended use.
+ */
+class Logger {
+public:
+  /**
+   * @brief Starts a logger for tasks of `pool` that writes to `fd`.
+   *
+   * @param pool The pool whose workers get a ring each.
+   * @param fd The file descriptor written to; not closed by the logger.
+   * @param options The ring size and collection interval.
+   */
+  explicit Logger(ThreadPool &pool, int fd = STDERR_FILENO,
+                  LoggerOptions options = {})
+      : pool_(pool), fd_(fd), options_(options),
+        wall_start_(std::chrono::system_clock::now()),
+        steady_start_(std::chrono::steady_clock::now()) {
+    rings_.reserve(pool.size() + 1);
+    for (std::size_t i = 0; i <= pool.size(); ++i) {
+      rings_.push_back(
+          std::make_unique<internal::LogRing>(options_.ring_records));
+    }
+    thread_ = std::jthread([this](std::stop_token token) { run(token); });
+  }
+
+  Logger(Logger const &other) = delete;
+  Logger &operator=(Logger const &other) = delete;
+
+  /**
+   * @brief Logs a record. `{}` in `format` is replaced by the next argument.
+   *
+   * @param format The format; must outlive the logger's next write.
+   * @param args Arithmetic values, pointers, and strings as `char const *`.
+   */
+  template <Loggable... Args> void log(char const *format, Args... args) {
+    static_assert((sizeof(Args) + ... + 0) <= internal::LOG_ARGS_BYTES,
+                  "too many bytes of arguments for one log record");
+    if (ThreadPool::current() == &pool_) {
+      write(*rings_[ThreadPool::current_worker()], format, args...);
+      return;
+    }
+    std::lock_guard lock(external_mutex_);
+    write(*rings_.back(), format, args...);
+  }
+
+  /**
+   * @brief Returns once every record logged before the call is written.
+   */
+  void flush() {
+    std::unique_lock lock(mutex_);
+    std::uint64_t target = passes_ + 2;
+    flush_requested_ = true;
+    wake_.notify_all();
+    /* The pass running now may have missed records; the next one cannot. */
+    done_.wait(lock, [&] { return passes_ >= target; });
+  }
+
+  /**
+   * @brief Returns the number of records dropped because a ring was full.
+   */
+  std::uint64_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Destructor. Writes the remaining records and stops the background
+   * thread.
+   */
+  ~Logger() {
+    thread_.request_stop();
+    thread_.join();
+    collect();
+  }
+
+private:
+  using Entry = std::pair<internal::LogRecord, std::size_t>;
+
+  ThreadPool &pool_;
+  int fd_;
+  LoggerOptions options_;
+  std::chrono::system_clock::time_point wall_start_;
+  std::chrono::steady_clock::time_point steady_start_;
+  std::vector<std::unique_ptr<internal::LogRing>> rings_; // Last: external
+  Mutex external_mutex_; // Serializes threads outside the pool
+  std::atomic<std::uint64_t> dropped_ = 0;
+
+  std::mutex mutex_;                 // Guards passes_ and flush_requested_
+  std::condition_variable_any wake_; // Wakes the background thread early
+  std::condition_variable done_;     // Signaled after every pass
+  std::uint64_t passes_ = 0;
+  bool flush_requested_ = false;
+
+  /* Used by the background thread only. */
+  std::vector<Entry> batch_;
+  std::vector<std::string> lines_;
+  std::vector<iovec> iov_;
+
+  std::jthread thread_; // Declared last, so it stops first
+
+  template <typename... Args>
+  void write(internal::LogRing &ring, char const *format, Args... args) {
+    internal::LogRecord *record = ring.reserve();
+    if (!record) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    record->time = std::chrono::steady_clock::now().time_since_epoch().count();
+    record->format = format;
+    record->render = &internal::renderRecord<Args...>;
+    std::size_t offset = 0;
+    ((std::memcpy(record->args + offset, &args, sizeof(Args)),
+      offset += sizeof(Args)),
+     ...);
+    ring.commit();
+  }
+
+  void run(std::stop_token token) {
+    while (!token.stop_requested()) {
+      collect();
+      std::unique_lock lock(mutex_);
+      ++passes_;
+      done_.notify_all();
+      if (!flush_requested_) {
+        wake_.wait_for(lock, token, options_.interval,
+                       [this] { return flush_requested_; });
+      }
+      flush_requested_ = false;
+    }
+    std::lock_guard lock(mutex_);
+    passes_ += 2;
+    done_.notify_all();
+  }
+
+  /**
+   * @brief Takes the records of all rings, merges them by time, and writes
+   * them out.
+   */
+  void collect() {
+    batch_.clear();
+    for (std::size_t i = 0; i < rings_.size(); ++i) {
+      rings_[i]->drainTo(batch_, i);
+    }
+    if (batch_.empty()) {
+      return;
+    }
+    /* Each ring is in order already; the sort interleaves them. */
+    std::stable_sort(batch_.begin(), batch_.end(),
+                     [](Entry const &a, Entry const &b) {
+                       return a.first.time < b.first.time;
+                     });
+    if (lines_.size() < batch_.size()) {
+      lines_.resize(batch_.size());
+    }
+    for (std::size_t i = 0; i < batch_.size(); ++i) {
+      format(lines_[i], batch_[i].first, batch_[i].second);
+    }
+    for (std::size_t first = 0; first < batch_.size();
+         first += internal::LOG_IOV_MAX) {
+      std::size_t count =
+          std::min(internal::LOG_IOV_MAX, batch_.size() - first);
+      iov_.resize(count);
+      for (std::size_t i = 0; i < count; ++i) {
+        iov_[i] = {lines_[first + i].data(), lines_[first + i].size()};
+      }
+      writeAll();
+    }
+  }
+
+  /**
+   * @brief Formats a record as `<seconds>.<microseconds> <worker> <message>`,
+   * with `-` as the worker for threads outside the pool.
+   */
+  void format(std::string &line, internal::LogRecord const &record,
+              std::size_t source) {
+    using namespace std::chrono;
+    auto since_start = steady_clock::duration(record.time) -
+                       steady_start_.time_since_epoch();
+    auto wall = duration_cast<microseconds>(
+        (wall_start_ + duration_cast<system_clock::duration>(since_start))
+            .time_since_epoch());
+    char buffer[32];
+    line.clear();
+    internal::appendArg(line,
+                        static_cast<std::int64_t>(wall.count() / 1000000));
+    line += '.';
+    auto micros = std::to_chars(buffer, buffer + sizeof buffer,
+                                wall.count() % 1000000 + 1000000);
+    line.append(buffer + 1, micros.ptr); // Keeps the leading zeros
+    line += ' ';
+    if (source < pool_.size()) {
+      internal::appendArg(line, source);
+    } else {
+      line += '-';
+    }
+    line += ' ';
+    record.render(line, record.format, record.args);
+    line += '\n';
+  }
+
+  /**
+   * @brief Writes iov_ completely, resuming after partial writes.
+   */
+  void writeAll() {
+    iovec *iov = iov_.data();
+    int count = static_cast<int>(iov_.size());
+    while (count > 0) {
+      ssize_t written = writev(fd_, iov, count);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return; // Nowhere to report the error; drop the batch.
+      }
+      auto left = static_cast<std::size_t>(written);
+      while (count > 0 && left >= iov->iov_len) {
+        left -= iov->iov_len;
+        ++iov;
+        --count;
+      }
+      if (count > 0) {
+        iov->iov_base = static_cast<char *>(iov->iov_base) + left;
+        iov->iov_len -= left;
+      }
+    }
+  }
+};
+
+} // namespace async
+
+#endif // defined(__unix__)
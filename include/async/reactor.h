@@ -0,0 +1,339 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <async/mutex.h>
+#include <async/threadpool.h>
+
+namespace async {
+
+namespace internal {
+
+/* Most events a worker takes from the epoll instance per poll. */
+inline constexpr int REACTOR_EVENTS = 64;
+
+/**
+ * @brief Lets a Reactor install itself as the poller of ThreadPool.
+ */
+struct ReactorAccess {
+  using Poller = ThreadPool::Poller;
+
+  static void attach(ThreadPool &pool, Poller const *poller) {
+    assert(!pool.poller_.load(std::memory_order_relaxed) &&
+           "ThreadPool already has a Reactor");
+    pool.poller_.store(poller, std::memory_order_seq_cst);
+    /* Workers that parked before only wait on their semaphores; wake them so
+     * that one of them moves into the poller. */
+    pool.ensureStarted();
+    pool.wakeParkedWorker();
+  }
+
+  /* Returns once no thread uses the poller any more. */
+  static void detach(ThreadPool &pool, Poller const *poller) {
+    pool.poller_.store(nullptr, std::memory_order_seq_cst);
+    while (pool.poller_users_.load(std::memory_order_acquire) > 0) {
+      poller->interrupt(poller->context);
+      std::this_thread::yield();
+    }
+  }
+
+  template <typename Predicate>
+  static void waitUntil(ThreadPool &pool, Predicate &&done) {
+    pool.waitUntil(std::forward<Predicate>(done));
+  }
+};
+
+} // namespace internal
+
+/**
+ * @brief The readiness a Reactor watches a file descriptor for.
+ */
+enum class Interest : std::uint32_t {
+  Read = EPOLLIN | EPOLLRDHUP,
+  Write = EPOLLOUT,
+  ReadWrite = EPOLLIN | EPOLLRDHUP | EPOLLOUT,
+};
+
+/**
+ * @brief Dispatches readiness of file descriptors, such as sockets, as tasks
+ * on a ThreadPool, without a thread of its own.
+ *
+ * The pool's workers poll the reactor's epoll instance themselves: a worker
+ * that runs out of work checks for events before it parks, and one parked
+ * worker at a time waits in epoll_wait() instead of on its semaphore. Work
+ * pushed to that worker interrupts the wait through an eventfd. Each ready
+ * file descriptor becomes a task on the polling worker's own deque, from
+ * which other workers steal, so a connection is handled by the worker that
+ * saw it become ready, without a hand-off from a separate network thread.
+ *
+ * Watches are one-shot under the hood: a descriptor is rearmed only once its
+ * callback has returned, so the callback of one descriptor never runs
+ * concurrently with itself, while any number of descriptors are served in
+ * parallel. Callbacks should read or write until the descriptor would block,
+ * on non-blocking descriptors; readiness may also be reported spuriously.
+ *
+ * Events are only seen while some worker is idle; a pool that never runs out
+ * of work handles them late.
+ *
+ * @note A pool has at most one reactor, which must be destroyed before the
+ * pool. The destructor waits for dispatched callbacks, and must not be called
+ * from one of them.
+ */
+class Reactor {
+public:
+  /**
+   * @brief Called with the ready events, a mask of EPOLLIN, EPOLLOUT,
+   * EPOLLRDHUP, EPOLLHUP and EPOLLERR.
+   */
+  using Callback = fu2::unique_function<void(std::uint32_t events)>;
+
+  /**
+   * @brief Creates an epoll instance and makes the workers of `pool` poll it.
+   *
+   * @throws std::system_error if the epoll instance or eventfd cannot be
+   * created.
+   */
+  explicit Reactor(ThreadPool &pool) : pool_(pool) {
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_ < 0) {
+      throw std::system_error(errno, std::system_category(),
+                              "epoll_create1 failed");
+    }
+    wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_ < 0) {
+      int error = errno;
+      close(epoll_);
+      throw std::system_error(error, std::system_category(),
+                              "eventfd failed");
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_ID;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &event);
+    internal::ReactorAccess::attach(pool_, &poller_);
+  }
+
+  Reactor(Reactor const &other) = delete;
+  Reactor &operator=(Reactor const &other) = delete;
+
+  /**
+   * @brief Calls `callback` as a pool task every time `fd` becomes ready for
+   * `interest`, until remove() is called.
+   *
+   * @param fd The file descriptor, which must not be watched already.
+   * @param interest The readiness to watch for.
+   * @param callback Called with the ready events.
+   * @throws std::system_error if epoll rejects the descriptor.
+   */
+  void add(int fd, Interest interest, Callback callback) {
+    auto watch = std::make_shared<Watch>();
+    watch->fd = fd;
+    watch->interest = static_cast<std::uint32_t>(interest);
+    watch->callback = std::move(callback);
+    arm(std::move(watch));
+  }
+
+  /**
+   * @brief Stops watching `fd`. A callback that is already running or
+   * dispatched may still finish, but the descriptor is not rearmed.
+   */
+  void remove(int fd) {
+    std::lock_guard lock(mutex_);
+    auto it = ids_.find(fd);
+    if (it == ids_.end()) {
+      return;
+    }
+    auto watch = watches_.find(it->second);
+    watch->second->removed.store(true, std::memory_order_relaxed);
+    watches_.erase(watch);
+    ids_.erase(it);
+    epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+  }
+
+  /**
+   * @brief An awaitable that suspends the awaiting coroutine until `fd` is
+   * ready, and resumes it as a pool task. Yields the ready events.
+   */
+  struct ReadyAwaiter {
+    Reactor &reactor;
+    int fd;
+    Interest interest;
+    std::uint32_t events = 0;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> h) {
+      auto watch = std::make_shared<Watch>();
+      watch->fd = fd;
+      watch->interest = static_cast<std::uint32_t>(interest);
+      watch->waiter = h;
+      watch->result = &events;
+      /* The coroutine may be resumed before arm() returns, so this awaiter
+       * must not be touched afterwards. */
+      reactor.arm(std::move(watch));
+    }
+
+    std::uint32_t await_resume() const noexcept { return events; }
+  };
+
+  /**
+   * @brief Returns an awaitable for the next readiness of `fd`, for use in a
+   * Job or other coroutine: `co_await reactor.ready(fd, Interest::Read)`.
+   * The descriptor must not be watched with add() at the same time.
+   */
+  ReadyAwaiter ready(int fd, Interest interest) {
+    return ReadyAwaiter{*this, fd, interest};
+  }
+
+  /**
+   * @brief Destructor. Detaches from the pool and waits for the callbacks that
+   * have been dispatched.
+   */
+  ~Reactor() {
+    internal::ReactorAccess::detach(pool_, &poller_);
+    internal::ReactorAccess::waitUntil(pool_, [this] {
+      return dispatched_.load(std::memory_order_acquire) == 0;
+    });
+    close(wake_);
+    close(epoll_);
+  }
+
+private:
+  /* epoll data of the eventfd; watches are numbered from 1. */
+  static constexpr std::uint64_t WAKE_ID = 0;
+
+  /**
+   * @brief A watched file descriptor: either a callback to run on every
+   * readiness, or a coroutine to resume once.
+   */
+  struct Watch {
+    int fd = -1;
+    std::uint64_t id = 0;
+    std::uint32_t interest = 0;
+    Callback callback;
+    std::coroutine_handle<> waiter;    // Set for ready() instead of callback
+    std::uint32_t *result = nullptr;   // Where ready() receives the events
+    std::atomic<bool> removed = false; // Set by remove()
+  };
+
+  ThreadPool &pool_;
+  int epoll_ = -1;
+  int wake_ = -1; // eventfd that interrupts a blocking poll
+  internal::ReactorAccess::Poller const poller_{
+      this,
+      [](void *self, bool block) {
+        return static_cast<Reactor *>(self)->poll(block);
+      },
+      [](void *self) { static_cast<Reactor *>(self)->interrupt(); }};
+
+  Mutex mutex_; // Guards the maps below and rearming
+  std::unordered_map<std::uint64_t, std::shared_ptr<Watch>> watches_;
+  std::unordered_map<int, std::uint64_t> ids_; // Watch id of each fd
+  std::uint64_t next_id_ = WAKE_ID + 1;
+  std::atomic<std::size_t> dispatched_ = 0; // Callbacks queued or running
+
+  void arm(std::shared_ptr<Watch> watch) {
+    std::lock_guard lock(mutex_);
+    watch->id = next_id_++;
+    epoll_event event{};
+    event.events = watch->interest | EPOLLONESHOT;
+    event.data.u64 = watch->id;
+    if (epoll_ctl(epoll_, EPOLL_CTL_ADD, watch->fd, &event) != 0) {
+      throw std::system_error(errno, std::system_category(),
+                              "epoll_ctl failed");
+    }
+    ids_[watch->fd] = watch->id;
+    watches_.emplace(watch->id, std::move(watch));
+  }
+
+  /**
+   * @brief Takes ready events from epoll and spawns a task for each, on the
+   * calling worker's deque.
+   */
+  bool poll(bool block) {
+    epoll_event events[internal::REACTOR_EVENTS];
+    int n;
+    do {
+      n = epoll_wait(epoll_, events, internal::REACTOR_EVENTS,
+                     block ? -1 : 0);
+    } while (n < 0 && errno == EINTR);
+
+    bool dispatched = false;
+    std::lock_guard lock(mutex_);
+    for (int i = 0; i < n; ++i) {
+      if (events[i].data.u64 == WAKE_ID) {
+        std::uint64_t count;
+        while (read(wake_, &count, sizeof count) > 0) {
+        }
+        continue;
+      }
+      auto it = watches_.find(events[i].data.u64);
+      if (it == watches_.end()) {
+        continue; // Removed since epoll reported it
+      }
+      std::shared_ptr<Watch> watch = it->second;
+      if (watch->waiter) {
+        watches_.erase(it);
+        ids_.erase(watch->fd);
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, watch->fd, nullptr);
+      }
+      dispatched_.fetch_add(1, std::memory_order_relaxed);
+      pool_.spawn([this, watch = std::move(watch), ready = events[i].events] {
+        run(*watch, ready);
+        dispatched_.fetch_sub(1, std::memory_order_release);
+      });
+      dispatched = true;
+    }
+    return dispatched;
+  }
+
+  /**
+   * @brief Runs the callback of `watch` and rearms it, or resumes its waiter.
+   */
+  void run(Watch &watch, std::uint32_t ready) {
+    if (watch.waiter) {
+      *watch.result = ready;
+      watch.waiter.resume();
+      return;
+    }
+    if (watch.removed.load(std::memory_order_relaxed)) {
+      return;
+    }
+    watch.callback(ready);
+    std::lock_guard lock(mutex_);
+    /* Checked under the lock, as the fd may have been closed and reused for
+     * a new watch since remove(). */
+    if (!watch.removed.load(std::memory_order_relaxed)) {
+      epoll_event event{};
+      event.events = watch.interest | EPOLLONESHOT;
+      event.data.u64 = watch.id;
+      epoll_ctl(epoll_, EPOLL_CTL_MOD, watch.fd, &event);
+    }
+  }
+
+  void interrupt() {
+    std::uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = write(wake_, &one, sizeof one);
+  }
+};
+
+} // namespace async
+
+#endif // defined(__linux__)
@@ -2,8 +2,9 @@
 
 // The following code is taken Jeff Preshing's github repository
 // https://github.com/preshing/cpp11-on-multicore
-// The code has been wrapped in the namespace of the project, otherwise no
-// change has been made to the code.
+// The code has been wrapped in the namespace of the project, and
+// LightweightSemaphore::wait() and signal() let fibers park instead of
+// blocking; otherwise no change has been made to the code.
 //
 //
 // LICENSE
@@ -141,6 +142,105 @@ public:
 
 #endif
 
+/* Makes a parked fiber runnable again. */
+struct Waker {
+  void *fiber = nullptr;
+  void (*wake)(void *fiber) = nullptr;
+
+  void operator()() const { wake(fiber); }
+};
+
+/* The fiber running on a thread (see async/fiber.h). A blocking wait hands
+ * `waker` to whatever ends the wait and calls park(), which switches back to
+ * the worker instead of blocking the thread. park() returns once the waker
+ * has been called, possibly before park() was; each call of the waker must
+ * be matched by one call of park(). */
+struct FiberContext {
+  Waker waker;
+  void (*park)();
+};
+
+/* Set while the calling thread runs a fiber. */
+inline thread_local FiberContext const *current_fiber = nullptr;
+
+/* A fiber parked in LightweightSemaphore::wait(), on the fiber's stack. */
+struct FiberWaiter {
+  Waker waker;
+  FiberWaiter *prev = nullptr;
+  FiberWaiter *next = nullptr;
+  bool queued = false;
+};
+
+/* The fibers parked on a semaphore, oldest first. The lock is only held for
+ * a few pointer updates, so it spins. */
+class FiberWaitList {
+public:
+  bool empty() const noexcept {
+    return size_.load(std::memory_order_seq_cst) == 0;
+  }
+
+  void push(FiberWaiter &waiter) {
+    lock();
+    waiter.prev = tail_;
+    waiter.next = nullptr;
+    (tail_ ? tail_->next : head_) = &waiter;
+    tail_ = &waiter;
+    waiter.queued = true;
+    size_.fetch_add(1, std::memory_order_seq_cst);
+    unlock();
+  }
+
+  /* Returns false if a signaler has taken the waiter already. */
+  bool remove(FiberWaiter &waiter) {
+    lock();
+    bool queued = waiter.queued;
+    if (queued) {
+      unlink(waiter);
+    }
+    unlock();
+    return queued;
+  }
+
+  /* Wakes up to `count` of the oldest waiters. */
+  void wake(int count) {
+    while (count-- > 0) {
+      lock();
+      FiberWaiter *waiter = head_;
+      if (!waiter) {
+        unlock();
+        return;
+      }
+      unlink(*waiter);
+      /* The waiter is gone as soon as its fiber runs again. */
+      Waker waker = waiter->waker;
+      unlock();
+      waker();
+    }
+  }
+
+private:
+  std::atomic_flag locked_;
+  std::atomic<int> size_{0};
+  FiberWaiter *head_ = nullptr;
+  FiberWaiter *tail_ = nullptr;
+
+  void lock() {
+    while (locked_.test_and_set(std::memory_order_acquire)) {
+      while (locked_.test(std::memory_order_relaxed)) {
+      }
+    }
+  }
+
+  void unlock() { locked_.clear(std::memory_order_release); }
+
+  void unlink(FiberWaiter &waiter) {
+    (waiter.prev ? waiter.prev->next : head_) = waiter.next;
+    (waiter.next ? waiter.next->prev : tail_) = waiter.prev;
+    waiter.queued = false;
+    size_.fetch_sub(1, std::memory_order_relaxed);
+  }
+};
+
 } // namespace internal
 
 //---------------------------------------------------------
@@ -150,6 +250,7 @@ class LightweightSemaphore {
 private:
   std::atomic<int> m_count;
   internal::Semaphore m_sema;
+  internal::FiberWaitList m_fibers;
 
   void waitWithPartialSpinning() {
     int oldCount;
@@ -173,6 +274,24 @@ private:
     }
   }
 
+  void waitOnFiber(internal::FiberContext const &fiber) {
+    internal::FiberWaiter waiter{fiber.waker};
+    while (true) {
+      m_fibers.push(waiter);
+      // Pairs with signal(): either the count is seen here, or the signaler
+      // sees the waiter.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (tryWait()) {
+        if (!m_fibers.remove(waiter))
+          fiber.park(); // A signaler took the waiter and is waking it
+        return;
+      }
+      fiber.park();
+      if (tryWait())
+        return;
+    }
+  }
+
 public:
   LightweightSemaphore(int initialCount = 0) : m_count(initialCount) {
     assert(initialCount >= 0);
@@ -186,16 +305,24 @@ public:
   }
 
   void wait() {
-    if (!tryWait())
-      waitWithPartialSpinning();
+    if (tryWait())
+      return;
+    if (internal::FiberContext const *fiber = internal::current_fiber) {
+      waitOnFiber(*fiber);
+      return;
+    }
+    waitWithPartialSpinning();
   }
 
   void signal(int count = 1) {
-    int oldCount = m_count.fetch_add(count, std::memory_order_release);
+    int oldCount = m_count.fetch_add(count, std::memory_order_seq_cst);
     int toRelease = -oldCount < count ? -oldCount : count;
     if (toRelease > 0) {
       m_sema.signal(toRelease);
     }
+    if (!m_fibers.empty()) {
+      m_fibers.wake(count);
+    }
   }
 };
 
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <async/internal/mpsc.h>
+#include <async/threadpool.h>
+
+namespace async {
+
+namespace internal {
+
+/* Default number of tasks a worker runs from one strand before handing the
+ * strand back to the pool, so that a busy strand cannot keep a worker from its
+ * other work. */
+inline constexpr std::size_t STRAND_BATCH = 64;
+
+} // namespace internal
+
+/**
+ * @brief A serial executor on top of a ThreadPool.
+ *
+ * Tasks posted to a strand run one at a time, in the order in which they were
+ * posted, but on the pool's workers rather than on a dedicated thread. State
+ * that is only touched by a strand's tasks therefore needs no lock: instead of
+ * contending for a mutex, callers queue their work on the strand.
+ *
+ * Posting pushes onto a lock-free queue. Whenever the strand goes from idle to
+ * busy, a single drain task is spawned on the pool; the worker that picks it
+ * up runs up to a batch of queued tasks in a row, which keeps the strand's
+ * state hot in that worker's cache, and then respawns the drain task if more
+ * tasks are waiting.
+ *
+ * @note The strand must outlive its tasks. The destructor waits for queued
+ * tasks to finish, and must not be called from one of them.
+ */
+class Strand {
+public:
+  /**
+   * @brief Constructs a strand that runs its tasks on `pool`.
+   *
+   * @param pool The thread pool on which the tasks run.
+   * @param batch The most tasks run in a row by one worker. Larger batches
+   * amortize scheduling; smaller ones share the workers more fairly.
+   */
+  explicit Strand(ThreadPool &pool, std::size_t batch = internal::STRAND_BATCH)
+      : pool_(pool), batch_(std::max<std::size_t>(1, batch)) {}
+
+  /**
+   * @brief Constructs a strand that runs its tasks on this_pool().
+   */
+  Strand() : Strand(this_pool()) {}
+
+  Strand(Strand const &other) = delete;
+  Strand &operator=(Strand const &other) = delete;
+
+  /**
+   * @brief Queues a task to run after all tasks posted before it. The task
+   * must not throw; use submit() to receive exceptions.
+   *
+   * @tparam F The type of the task function.
+   * @param f The task function to be executed.
+   */
+  template <std::invocable F> void post(F &&f) {
+    queue_.push(std::forward<F>(f));
+    if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+      schedule();
+    }
+  }
+
+  /**
+   * @brief Queues a task to run after all tasks posted before it and returns a
+   * future for its result.
+   *
+   * @param f The task function to be executed.
+   * @param args The arguments to be passed to the task function.
+   * @return The future object associated with the task result.
+   */
+  template <typename... Args, typename F>
+  std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+  submit(F &&f, Args &&... args) {
+    auto task = internal::Task(internal::bindFunctionToArguments(
+        std::forward<F>(f), std::forward<Args>(args)...));
+    auto future = task.get_future();
+    post(std::move(task));
+    return future;
+  }
+
+  /**
+   * @brief Returns the pool on which the strand's tasks run.
+   */
+  ThreadPool &pool() const noexcept { return pool_; }
+
+  /**
+   * @brief Destructor. Waits for the queued tasks to finish.
+   */
+  ~Strand() {
+    pool_.waitUntil(
+        [this] { return pending_.load(std::memory_order_acquire) == 0; });
+  }
+
+private:
+  using task_t = fu2::unique_function<void() &&>;
+
+  ThreadPool &pool_;                    // Pool on which the tasks run
+  std::size_t batch_;                   // Most tasks run per drain
+  internal::MpscQueue<task_t> queue_;   // Posted tasks that have not run yet
+  std::atomic<std::size_t> pending_{0}; // Posted tasks that have not finished
+
+  void schedule() {
+    pool_.spawn([this] { drain(); });
+  }
+
+  /**
+   * @brief Runs a batch of queued tasks. Only one drain task exists at a time,
+   * which is what makes the strand serial.
+   */
+  void drain() {
+    std::size_t ran = 0;
+    do {
+      std::optional<task_t> task;
+      /* The task is counted, so it is in the queue or about to be linked. */
+      while (!(task = queue_.pop())) {
+        std::this_thread::yield();
+      }
+      std::invoke(std::move(*task));
+      ++ran;
+    } while (ran < batch_ && ran < pending_.load(std::memory_order_acquire));
+
+    /* Once this reaches zero the strand may be destroyed, so `this` is only
+     * used again if tasks remain. */
+    if (pending_.fetch_sub(ran, std::memory_order_acq_rel) > ran) {
+      schedule();
+    }
+  }
+};
+
+} // namespace async
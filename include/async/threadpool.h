@@ -1,25 +1,50 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
 #include <cassert>
+#include <chrono>
 #include <concepts>
+#include <coroutine>
 #include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <ratio>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "async/concurrency.h"
 #include "async/deque.h"
 #include "function2/function2.hpp"
+#include <async/internal/thread.h>
+#include <async/internal/timer.h>
 #include <async/internal/xoroshiro128starstar.h>
+#include <async/mutex.h>
 #include <async/sem.h>
 
 namespace async {
 
 namespace internal {
 
+struct JobAccess;
+struct TaskAccess;
+struct FiberAccess;
+struct WatchdogAccess;
+struct ReactorAccess;
+
 /**
  * @brief Creates a decayed copy of the given value.
  *
@@ -109,6 +134,89 @@ private:
 
 } // namespace internal
 
+class Strand;
+
+/**
+ * @brief What submit() does when the pool already holds
+ * AdmissionPolicy::max_queued tasks.
+ */
+enum class Overflow {
+  /* Wait until the queue has room. A worker of the pool runs other tasks
+   * while it waits. */
+  Block,
+  /* Throw QueueFullError. */
+  Reject,
+  /* Run the task right away on the submitting thread. */
+  CallerRuns,
+  /* Discard the oldest task queued by submit() to make room. Its future
+   * reports std::future_errc::broken_promise. */
+  DropOldest,
+};
+
+/**
+ * @brief Thrown by submit() when the queue is full and the overflow policy is
+ * Overflow::Reject.
+ */
+class QueueFullError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Limits on the number of tasks queued in a ThreadPool, and callbacks
+ * that report when the queue grows deep.
+ *
+ * The queue depth counts every task that is waiting to run, whether it was
+ * submitted or spawned. Only submit() is subject to the limit, since refusing
+ * a spawned task would leave its TaskGroup waiting forever. The limit is
+ * approximate: concurrent submitters may overshoot it slightly.
+ */
+struct AdmissionPolicy {
+  std::size_t max_queued = 0; // Limit on the queue depth; 0 means unbounded
+  Overflow overflow = Overflow::Block; // What to do when the limit is reached
+
+  /* on_high is called once the depth reaches high_watermark, and on_low once
+   * it falls back to low_watermark. Each is called once per crossing, on
+   * whichever thread caused it, so both must be quick. A zero high_watermark
+   * disables them. */
+  std::size_t high_watermark = 0;
+  std::size_t low_watermark = 0;
+  std::function<void(std::size_t)> on_high = {};
+  std::function<void(std::size_t)> on_low = {};
+};
+
+/**
+ * @brief Whether a task submitted to a specific worker may run elsewhere.
+ */
+enum class Affinity {
+  /* Prefer the target worker, but let idle workers steal the task. */
+  Soft,
+  /* Run the task only on the target worker. */
+  Hard,
+};
+
+/**
+ * @brief Settings of the worker threads of a ThreadPool.
+ */
+struct WorkerOptions {
+  /* Stack size of each worker in bytes; 0 keeps the platform default, which
+   * is often 8 MiB of reserved address space per worker. Sizes below
+   * ThreadPool::MIN_STACK_BYTES are raised to it. If a worker cannot get a
+   * stack of this size, pushing tasks to the pool throws. */
+  std::size_t stack_size = 0;
+  /* Workers are named "<name>-<index>", as shown by top and perf. */
+  std::string name = "async";
+  /* Scheduling policy, and the priority for the real-time policies. */
+  SchedPolicy policy = SchedPolicy::Inherit;
+  int priority = 0;
+  /* Nice level of the workers; empty keeps the inherited one. */
+  std::optional<int> nice = {};
+  /* Called on each worker, with its index, before it runs its first task and
+   * after it has run its last one; e.g. to set up thread-local caches. */
+  std::function<void(std::size_t)> on_start = {};
+  std::function<void(std::size_t)> on_stop = {};
+};
+
 /**
  * @brief A thread pool implementation for executing tasks in parallel.
  *
@@ -127,40 +235,34 @@ public:
   /**
    * @brief Constructs a ThreadPool with a specified number of threads.
    *
-   * @param nthreads The number of threads in the thread pool. Defaults to the
-   * number of hardware threads available.
+   * No threads are started until the first task is pushed (or prewarm() is
+   * called), so constructing a pool that is never used is cheap. The workers
+   * are then started as a binary tree: worker i starts workers 2i + 1 and
+   * 2i + 2, so startup takes O(log n) thread creations on the critical path.
+   * If a worker thread cannot be started, pushing tasks and prewarm() throw
+   * the std::system_error that reported it.
+   *
+   * @param nthreads The number of threads in the thread pool. Defaults to
+   * recommended_concurrency(), which respects the CPU affinity mask and cgroup
+   * CPU quota of the process.
    */
-  explicit ThreadPool(
-      std::size_t nthreads = std::thread::hardware_concurrency())
-      : queues_(nthreads) {
-    for (std::size_t i = 0; i < nthreads; ++i) {
-      threads_.emplace_back([&, id = i](std::stop_token token) {
-        /* Worker thread routine */
-        prng::jump(); /* Creates a large non-overlapping sequence to generate
-                         random numbers */
-        do {
-          /* Wait for task to pushed and worker to be signaled. */
-          queues_[id].sem.wait();
-          std::size_t spin_count = 0;
-          do {
-            /* Decide whether to work on one's own queue or from a random
-             * worker. */
-            std::size_t slot = spin_count++ < 100 || !queues_[id].dq.empty()
-                                   ? id
-                                   : prng::next() % queues_.size();
-
-            if (std::optional fetched_task = queues_[slot].dq.steal()) {
-              pending_task_count_.fetch_sub(1, std::memory_order_release);
-              std::invoke(std::move(*fetched_task));
-            }
-
-            /* Work until all tasks are finished */
-          } while (pending_task_count_.load(std::memory_order_acquire) > 0);
+  explicit ThreadPool(std::size_t nthreads = recommended_concurrency())
+      : ThreadPool(nthreads, WorkerOptions{}) {}
 
-        } while (!token.stop_requested());
-      });
-    }
-  }
+  /**
+   * @brief Constructs a ThreadPool whose workers use the given stack size,
+   * name, scheduling settings and start and stop hooks.
+   *
+   * Scheduling settings that the process is not permitted to make, such as
+   * real-time policies without the needed privilege, are skipped.
+   *
+   * @param nthreads The number of threads in the thread pool.
+   * @param options The settings of the worker threads.
+   */
+  ThreadPool(std::size_t nthreads, WorkerOptions options)
+      : queues_(nthreads), threads_(nthreads),
+        max_searching_(std::max<std::size_t>(1, nthreads / 2)),
+        surplus_((nthreads + 63) / 64), worker_options_(std::move(options)) {}
 
   /**
    * @brief Submits a task to the thread pool for execution.
@@ -177,6 +279,227 @@ public:
   std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
   submit(F &&f, Args &&... args);
 
+  /**
+   * @brief Schedules a task without creating a future for its result.
+   *
+   * When called from one of the pool's own workers, the task is pushed onto
+   * that worker's local deque, where it is run in LIFO order by the worker and
+   * stolen in FIFO order by idle workers. Otherwise the task is submitted like
+   * submit().
+   *
+   * @tparam F The type of the task function.
+   * @param f The task function to be executed.
+   */
+  template <std::invocable F> void spawn(F &&f);
+
+  /**
+   * @brief Submits a task to be run by the worker with index `worker`.
+   *
+   * Use this to run work on the worker whose cache already holds its data,
+   * e.g. shard `i` of a partitioned data set on worker `i % size()`. The task
+   * goes to the worker's affinity mailbox, which the worker checks before its
+   * external deque. With Affinity::Soft idle workers may still steal the task
+   * once they run out of other work; with Affinity::Hard only the target
+   * worker runs it.
+   *
+   * @param worker The index of the target worker, less than size().
+   * @param affinity Whether other workers may run the task.
+   * @param f The task function to be executed.
+   * @param args The arguments to be passed to the task function.
+   * @return The future object associated with the task result.
+   */
+  template <typename... Args, typename F>
+  std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+  submit_to(std::size_t worker, Affinity affinity, F &&f, Args &&... args);
+
+  /**
+   * @brief Submits a task with soft affinity to the worker with index
+   * `worker`.
+   */
+  template <typename... Args, typename F>
+    requires(!std::same_as<std::decay_t<F>, Affinity>)
+  std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+  submit_to(std::size_t worker, F &&f, Args &&... args) {
+    return submit_to(worker, Affinity::Soft, std::forward<F>(f),
+                     std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief Blocks until `future` is ready.
+   *
+   * Unlike `future.wait()`, a worker of this pool keeps running pending tasks
+   * while it waits, so a task can wait for tasks it submitted to its own pool
+   * without deadlocking it.
+   *
+   * @tparam T The result type of the future.
+   * @param future The future to wait for.
+   */
+  template <typename T> void wait(std::future<T> const &future);
+
+  /**
+   * @brief Returns the number of worker threads in the thread pool.
+   */
+  std::size_t size() const noexcept { return queues_.size(); }
+
+  /**
+   * @brief Returns the pool whose worker is running the calling thread, or
+   * nullptr when called from a thread that does not belong to any pool.
+   */
+  static ThreadPool *current() noexcept { return current_pool_; }
+
+  /**
+   * @brief Returns the index of the worker running the calling thread within
+   * current(). Only meaningful when current() is not nullptr.
+   */
+  static std::size_t current_worker() noexcept { return current_id_; }
+
+  /**
+   * @brief Starts all workers now and waits until each of them is running and
+   * has faulted in the first PREWARM_STACK_BYTES of its stack.
+   *
+   * Call this ahead of a latency-critical phase so that the first tasks do not
+   * pay for thread creation and page faults. Blocks until every worker is idle
+   * long enough to take part, and must not be called from a worker of this
+   * pool.
+   *
+   * @throws std::system_error if a worker thread could not be started.
+   */
+  void prewarm();
+
+  /* Amount of each worker's stack touched by prewarm(). */
+  static constexpr std::size_t PREWARM_STACK_BYTES = 64 * 1024;
+
+  /* Smallest stack size applied from WorkerOptions::stack_size. */
+  static constexpr std::size_t MIN_STACK_BYTES = 4 * PREWARM_STACK_BYTES;
+
+  /* How long a task may run while other tasks are waiting before
+   * this_task::should_yield() asks it to give up its worker. */
+  static constexpr std::chrono::microseconds YIELD_SLICE{1000};
+
+  /**
+   * @brief Limits how many idle workers may look for work in other workers'
+   * deques at the same time. Defaults to half the workers.
+   *
+   * Workers beyond the limit park instead of picking random victims. A
+   * searching worker that finds work wakes a parked worker to take over the
+   * search, so the number of thieves grows only while there is work to steal.
+   *
+   * @param n The maximum number of searching workers. At least 1 is used.
+   */
+  void set_max_searching(std::size_t n) noexcept {
+    max_searching_.store(std::max<std::size_t>(1, n),
+                         std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Settings of proactive work sharing; see set_work_sharing().
+   */
+  struct WorkSharing {
+    /* Depth of a worker's local deque above which the worker advertises its
+     * surplus to thieves; 0 turns work sharing off. */
+    std::size_t surplus_threshold = 0;
+    /* Whether a worker with surplus also hands its oldest task to a parked
+     * worker while no worker is searching. */
+    bool push_to_parked = false;
+  };
+
+  /**
+   * @brief Turns proactive work sharing on or off. Off by default.
+   *
+   * Random stealing finds a single loaded worker among many idle ones only
+   * after many failed attempts. With work sharing, a worker whose local deque
+   * grows past the threshold sets its bit in a shared surplus bitmap, and
+   * searching workers steal from workers with their bit set before trying
+   * random victims. The bit is cleared once the deque has drained to half the
+   * threshold. With `push_to_parked`, the loaded worker also moves its oldest
+   * task into a parked worker's mailbox before waking it, so the woken worker
+   * starts with work instead of searching for it.
+   *
+   * @param sharing The new settings.
+   */
+  void set_work_sharing(WorkSharing sharing) noexcept {
+    push_to_parked_.store(sharing.push_to_parked, std::memory_order_relaxed);
+    surplus_threshold_.store(sharing.surplus_threshold,
+                             std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Turns coalescing of submitted tasks on or off. Off by default.
+   *
+   * When tasks are submitted faster than the workers drain them, pushing,
+   * counting and signaling each task costs more than running a small one.
+   * With coalescing, a task submitted to a worker whose queue already holds
+   * `min_depth` tasks is appended to a batch of up to COALESCE_BATCH tasks
+   * instead, which is queued, counted and signaled once and whose tasks run
+   * back to back. Below `min_depth`, as in an idle pool, tasks are queued one
+   * by one and start as early as before.
+   *
+   * Only worthwhile for tasks much shorter than the time a batch waits in the
+   * queue, since a long task delays the rest of its batch. A batch counts as a
+   * single task in queued() and the admission limits, and is never discarded
+   * by Overflow::DropOldest.
+   *
+   * Coalesced tasks must not wait on each other: a task later in a batch runs
+   * only after the ones before it have returned, and cannot be stolen in the
+   * meantime, so a task blocking on one behind it deadlocks.
+   *
+   * @param min_depth The queue depth from which tasks are coalesced; 0 turns
+   * coalescing off.
+   */
+  void set_coalescing(std::size_t min_depth) noexcept {
+    coalesce_depth_.store(min_depth, std::memory_order_relaxed);
+  }
+
+  /* Most tasks coalesced into one batch; see set_coalescing(). */
+  static constexpr std::size_t COALESCE_BATCH = 16;
+
+  /**
+   * @brief Counters of the work-stealing activity of the workers.
+   */
+  struct Stats {
+    std::uint64_t steal_attempts; // Steals tried on a non-empty victim deque
+    std::uint64_t failed_steals;  // Steals that lost the race for the task
+    std::size_t searching;        // Workers looking for work to steal now
+  };
+
+  /**
+   * @brief Returns the work-stealing counters summed over all workers, and
+   * the number of workers searching at the time of the call.
+   */
+  Stats stats() const noexcept;
+
+  /**
+   * @brief Sets the limits applied to submit() and the queue-depth
+   * callbacks.
+   *
+   * Safe to call while tasks are submitted and run: submitters and workers
+   * switch to the new policy as they next read it. Every policy set is kept
+   * until the pool is destroyed, so this is meant for occasional changes.
+   *
+   * @param policy The new admission policy.
+   */
+  void set_admission(AdmissionPolicy policy) {
+    AdmissionPolicy const *active = nullptr;
+    std::lock_guard lock(admission_mutex_);
+    if (policy.max_queued != 0 || policy.high_watermark != 0) {
+      active = admission_policies_
+                   .emplace_back(std::make_unique<AdmissionPolicy const>(
+                       std::move(policy)))
+                   .get();
+    }
+    admission_.store(active, std::memory_order_release);
+    /* Submitters blocked under the old limit check the new one. */
+    room_.signal(static_cast<int>(blocked_.load(std::memory_order_seq_cst)));
+  }
+
+  /**
+   * @brief Returns the number of tasks waiting to run.
+   */
+  std::size_t queued() const noexcept {
+    return static_cast<std::size_t>(std::max<std::int64_t>(
+        0, pending_task_count_.load(std::memory_order_relaxed)));
+  }
+
   /**
    * @brief Destructor.
    *
@@ -186,53 +509,1346 @@ public:
   ~ThreadPool();
 
 private:
+  friend class TaskGroup;
+  friend class Strand;
+  friend struct internal::JobAccess;
+  friend struct internal::TaskAccess;
+  friend struct internal::FiberAccess;
+  friend struct internal::WatchdogAccess;
+  friend struct internal::ReactorAccess;
+
+  using task_t = fu2::unique_function<void() &&>;
+
+  /**
+   * @brief A task pushed from outside the pool. Only tasks from submit() may be
+   * discarded by Overflow::DropOldest.
+   */
+  struct ExternalTask {
+    task_t task;
+    bool droppable;
+  };
+
+  /**
+   * @brief Tasks coalesced by externalPush(), queued as a single task.
+   *
+   * Submitters append under the target's submit lock, and the worker that
+   * runs the batch closes it first; a task appended after that is queued on
+   * its own instead. The state
+   * holds the number of tasks in its low bits and the closed flag above them.
+   */
+  struct Batch {
+    static constexpr std::uint32_t CLOSED = 1u << 31;
+
+    std::array<task_t, COALESCE_BATCH> tasks;
+    std::atomic<std::uint32_t> state = 0;
+
+    /**
+     * @brief Appends `task` unless the batch is full or closed, in which case
+     * `task` is left as it was.
+     */
+    bool append(task_t &task) {
+      std::uint32_t n = state.load(std::memory_order_relaxed);
+      if (n >= COALESCE_BATCH) { // Full, closed, or both
+        return false;
+      }
+      /* Slot n is unused until the count below includes it. */
+      tasks[n] = std::move(task);
+      if (!state.compare_exchange_strong(n, n + 1,
+                                         std::memory_order_release)) {
+        task = std::move(tasks[n]);
+        return false;
+      }
+      return true;
+    }
+
+    /**
+     * @brief Closes the batch and returns the number of tasks it holds.
+     */
+    std::uint32_t close() {
+      return state.fetch_or(CLOSED, std::memory_order_acquire) & ~CLOSED;
+    }
+  };
+
+  /**
+   * @brief A FIFO queue of tasks submitted to one worker with submit_to().
+   *
+   * Any thread may push to it, which a Deque does not allow at its owner's
+   * end, so it is guarded by a lock. The size is mirrored in an atomic so that
+   * empty mailboxes are skipped without taking the lock.
+   */
+  struct Mailbox {
+    Mutex mutex;
+    std::deque<task_t> tasks;
+    std::atomic<std::size_t> size = 0;
+
+    bool empty() const noexcept {
+      return size.load(std::memory_order_relaxed) == 0;
+    }
+
+    void push(task_t task) {
+      std::lock_guard lock(mutex);
+      tasks.push_back(std::move(task));
+      size.store(tasks.size(), std::memory_order_relaxed);
+    }
+
+    std::optional<task_t> take() {
+      if (empty()) {
+        return std::nullopt;
+      }
+      std::lock_guard lock(mutex);
+      if (tasks.empty()) {
+        return std::nullopt;
+      }
+      std::optional<task_t> task(std::move(tasks.front()));
+      tasks.pop_front();
+      size.store(tasks.size(), std::memory_order_relaxed);
+      return task;
+    }
+  };
+
+  /**
+   * @brief Progress of a worker, written only by the worker and sampled by a
+   * Watchdog. Kept on its own cache line, so the stores made for every task
+   * never contend with other threads.
+   */
+  struct alignas(64) Heartbeat {
+    std::atomic<std::uint64_t> tasks = 0;    // Tasks started
+    std::atomic<std::uint32_t> depth = 0;    // Tasks running, nested
+    std::atomic<char const *> tag = nullptr; // Tag of the innermost task
+  };
+
   /**
    * @brief Internal structure for storing a task queue associated with a
    * thread.
    */
   struct TaskQueue {
     DefaultSemaphoreType sem{0}; // Semaphore for thread synchronization
-    Deque<fu2::unique_function<void() &&>> dq; // Deque to store tasks
+    Deque<ExternalTask> dq;      // Deque to store externally pushed tasks
+    Mutex submit_mutex;          // Held to push to dq and to use batch
+    Deque<task_t> local;         // Deque of tasks spawned by the worker itself
+    Deque<std::coroutine_handle<>> continuations; // Forked Jobs' parents
+    Deque<std::coroutine_handle<>> yielded; // Coroutines that yielded, FIFO
+    Mailbox soft; // Tasks submitted to this worker that may be stolen
+    Mailbox hard; // Tasks submitted to this worker that must run here
+    std::size_t fibers = 0; // Fibers parked on this worker; owner only
+    std::shared_ptr<Batch> batch; // Batch still taking tasks
+    std::atomic<bool> parked = false; // Whether the worker waits on sem
+    std::atomic<bool> polling = false; // Whether it waits in the poller instead
+    bool searching = false; // Whether the worker counts in searching_count_
+    bool advertised = false; // Whether the worker's surplus bit is set
+
+    /* Written only by the owning worker, hence relaxed loads and stores. */
+    std::atomic<std::uint64_t> steal_attempts = 0;
+    std::atomic<std::uint64_t> failed_steals = 0;
+    Heartbeat heartbeat;
   };
 
+  /* Number of times a worker checks its own deques before it starts stealing
+   * from other workers. */
+  static constexpr std::size_t SPIN_LIMIT = 100;
+
+  /* Bounds of the delay after which a fiber waiting in waitUntil() checks
+   * again whether it is done. */
+  static constexpr std::chrono::microseconds FIBER_POLL_MIN{50};
+  static constexpr std::chrono::microseconds FIBER_POLL_MAX{1000};
+
   std::atomic<std::int64_t> pending_task_count_; // Counter for pending tasks
-  std::size_t rotating_index_ = 0;    // Index for rotating task distribution
+  std::atomic<std::size_t> rotating_index_ = 0; // Rotates task distribution
   std::vector<TaskQueue> queues_;     // Vector of task queues
-  std::vector<std::jthread> threads_; // Vector of worker threads
+  std::vector<internal::Thread> threads_; // Vector of worker threads
+  std::stop_source stop_;                  // Stops the workers
+  std::atomic<bool> start_requested_ = false; // Set once startup has begun
+  std::atomic<std::size_t> started_count_ = 0; // Number of threads launched
+  std::atomic<std::size_t> failed_count_ = 0;  // Threads that failed to start
+  std::mutex start_mutex_;                      // Guards start_error_
+  std::exception_ptr start_error_; // First failure to start a thread
+  std::atomic<std::size_t> max_searching_;      // Cap on searching workers
+  std::atomic<std::size_t> searching_count_ = 0; // Workers stealing right now
+
+  /* Proactive work sharing; see set_work_sharing(). */
+  std::atomic<std::size_t> surplus_threshold_ = 0; // 0 when sharing is off
+  std::atomic<bool> push_to_parked_ = false;
+  std::vector<std::atomic<std::uint64_t>> surplus_; // Bit per loaded worker
+
+  /* Queue depth from which submitted tasks are coalesced; 0 when off. */
+  std::atomic<std::size_t> coalesce_depth_ = 0;
+
+  /**
+   * @brief Something idle workers poll for events, such as a Reactor.
+   */
+  struct Poller {
+    void *context;
+    /* Dispatches pending events, first waiting for some if `block` is set.
+     * Returns whether any were dispatched. */
+    bool (*poll)(void *context, bool block);
+    /* Makes a blocking poll() return. */
+    void (*interrupt)(void *context);
+  };
+
+  std::atomic<Poller const *> poller_ = nullptr; // Set by a Reactor
+  std::atomic<bool> polling_ = false; // Held by the one worker polling
+  std::atomic<std::size_t> poller_users_ = 0; // Threads using poller_
+
+  /* Policy applied by submit(); null when it sets no limit. Policies are
+   * never freed before the pool, as other threads may still read them. */
+  std::atomic<AdmissionPolicy const *> admission_ = nullptr;
+  std::vector<std::unique_ptr<AdmissionPolicy const>> admission_policies_;
+  std::mutex admission_mutex_; // Guards admission_policies_
+  std::atomic<bool> above_high_ = false; // Depth reached the high watermark
+  std::atomic<std::size_t> blocked_ = 0; // Submitters waiting for room
+  DefaultSemaphoreType room_{0};         // Signaled when a task leaves
+
+  WorkerOptions worker_options_; // Settings of the worker threads
+
+  static inline thread_local ThreadPool *current_pool_ =
+      nullptr; // Pool of the worker running on this thread, if any
+  static inline thread_local std::size_t current_id_ =
+      0; // Index of the worker running on this thread
+
+  /* Time slice of the task running on this thread, for should_yield(). The
+   * slice of a task starts at its first check. */
+  static inline thread_local std::uint64_t tasks_started_ =
+      0; // Tasks started on this thread
+  static inline thread_local std::uint64_t slice_task_ =
+      ~std::uint64_t{0}; // tasks_started_ when the slice began
+  static inline thread_local std::chrono::steady_clock::time_point
+      slice_start_; // When the slice began
 
   /**
    * @brief Pushes a task to the thread pool from an external source.
    *
    * @tparam F The type of the task function.
    * @param f The task function to be executed.
+   * @param droppable Whether Overflow::DropOldest may discard the task.
+   * @param coalescable Whether the task may be coalesced into a batch; false
+   * for tasks that wait on other tasks pushed alongside them.
    */
-  template <std::invocable F> void externalPush(F &&f);
-};
+  template <std::invocable F>
+  void externalPush(F &&f, bool droppable = false, bool coalescable = true);
 
-template <typename... Args, typename F>
-[[nodiscard]] std::future<
-    std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
-ThreadPool::submit(F &&f, Args &&... args) {
-  auto task = internal::Task(internal::bindFunctionToArguments(
-      std::forward<F>(f), std::forward<Args>(args)...));
-  auto future = task.get_future();
-  externalPush(std::move(task));
-  return future;
-}
+  /**
+   * @brief Applies the admission policy to a task about to be submitted.
+   *
+   * @return false if the task was already run by the caller instead.
+   */
+  template <typename T> bool admit(AdmissionPolicy const &policy, T &task);
 
-template <std::invocable F> void ThreadPool::externalPush(F &&f) {
-  std::size_t slot = rotating_index_++ % queues_.size();
-  pending_task_count_.fetch_add(1, std::memory_order_relaxed);
-  queues_[slot].dq.push(std::forward<F>(f));
-  queues_[slot].sem.signal();
-}
+  /**
+   * @brief Queues `task` in the affinity mailbox of worker `worker` and wakes
+   * the worker. Safe to call from any thread.
+   */
+  void pushAffine(std::size_t worker, Affinity affinity, task_t task);
 
-ThreadPool::~ThreadPool() {
-  for (auto &t : threads_) {
-    t.request_stop();
-  }
-  for (auto &d : queues_) {
-    d.sem.signal();
+  /**
+   * @brief Blocks the calling submitter until the queue is below its limit.
+   */
+  void waitForRoom();
+
+  /**
+   * @brief Discards the oldest droppable task from the external deques.
+   * Older tasks that may not be dropped are moved to their worker's soft
+   * mailbox on the way, since only the submitter may push to a deque.
+   */
+  void dropOldest();
+
+  /**
+   * @brief Called whenever a task leaves the queues, with the new depth.
+   * Wakes blocked submitters and reports the low watermark.
+   */
+  void taskTaken(std::int64_t depth);
+
+  /**
+   * @brief Pushes the continuation of a job that forked a child onto the
+   * calling worker's continuation deque, where other workers can steal it.
+   * Must be called from a worker of this pool.
+   */
+  void pushContinuation(std::coroutine_handle<> continuation);
+
+  /**
+   * @brief Removes `continuation` from the calling thread's continuation deque
+   * if it is the newest entry there, i.e. if it was not stolen.
+   *
+   * @return true if the caller now owns the continuation and must resume it.
+   */
+  bool popContinuation(std::coroutine_handle<> continuation);
+
+  /**
+   * @brief Queues a coroutine that yielded behind all other work of the
+   * calling worker. Must be called from a worker of this pool.
+   */
+  void requeue(std::coroutine_handle<> h);
+
+  /**
+   * @brief Whether the task running on the calling worker should give up the
+   * worker; see this_task::should_yield().
+   */
+  bool shouldYield();
+
+  /**
+   * @brief Starts the workers on first use. Cheap once they are running.
+   */
+  void ensureStarted();
+
+  /**
+   * @brief Waits until every worker has started or failed to, and throws the
+   * first failure.
+   */
+  void waitStarted();
+
+  /**
+   * @brief Rethrows the first failure to start a worker, if any.
+   */
+  void throwIfStartFailed();
+
+  /**
+   * @brief Launches the thread of worker `id`. If that fails, records the
+   * error and launches the children of `id` from the calling thread instead.
+   */
+  void startWorker(std::size_t id) noexcept;
+
+  /**
+   * @brief Worker thread routine.
+   *
+   * @param token The stop token of the worker's thread.
+   * @param id The index of the worker.
+   */
+  void workerMain(std::stop_token token, std::size_t id);
+
+  /**
+   * @brief Runs at most one pending task on behalf of worker `id`.
+   *
+   * The worker's local deque is popped first, then its continuation deque,
+   * its affinity mailboxes, its external deque and its yielded coroutines.
+   * After `attempt` exceeds the spin limit while all are empty, tasks are
+   * stolen from a random worker instead.
+   *
+   * @param id The index of the calling worker.
+   * @param attempt The number of consecutive calls made by the worker so far.
+   * @return true if a task was run.
+   */
+  bool runPendingTask(std::size_t id, std::size_t attempt);
+
+  /**
+   * @brief Runs a task taken from the queues, keeping the heartbeat of the
+   * calling worker up to date.
+   */
+  template <typename F> void runTask(F &&f);
+
+
+  /**
+   * @brief Steals and runs at most one pending task from the worker with index
+   * `slot`. Safe to call from any thread.
+   *
+   * @return true if a task was run.
+   */
+  bool stealPendingTask(std::size_t slot);
+
+  /**
+   * @brief Steals a task from the worker with index `slot`, trying the
+   * external deque first, then the continuation deque, the local deque, the
+   * yielded coroutines and the soft affinity mailbox. Empty queues are
+   * skipped without writing to them.
+   */
+  std::optional<task_t> stealFrom(std::size_t slot);
+
+  /**
+   * @brief Makes worker `id` a searching worker, if the cap allows, and steals
+   * and runs at most one task from a random victim.
+   *
+   * @return true if a task was run.
+   */
+  bool searchPendingTask(std::size_t id);
+
+  /**
+   * @brief Removes worker `id` from the searching workers.
+   *
+   * @return true if the worker was searching.
+   */
+  bool stopSearching(std::size_t id);
+
+  /**
+   * @brief Advertises the surplus of worker `id`, whose local deque is deeper
+   * than the threshold, and hands its oldest task to a parked worker if work
+   * sharing asks for it. Must be called by the worker itself.
+   *
+   * @return true if a parked worker was given a task and woken.
+   */
+  bool shareSurplus(std::size_t id);
+
+  /**
+   * @brief Clears the surplus bit of worker `id` once its local deque has
+   * drained to half the threshold.
+   */
+  void retractSurplus(std::size_t id);
+
+  /**
+   * @brief Returns a worker that advertises surplus, if any.
+   */
+  std::optional<std::size_t> findSurplus() const noexcept;
+
+  /**
+   * @brief Signals one parked worker, if there is any.
+   */
+  void wakeParkedWorker();
+
+  /**
+   * @brief Signals the semaphore of a worker, and interrupts the poller if the
+   * worker waits in it.
+   */
+  void notify(TaskQueue &q);
+
+  /**
+   * @brief Polls the poller, if there is one and no other worker polls it.
+   * With `block` set, the worker waits in the poller instead of on its
+   * semaphore until there are events or it is signaled.
+   *
+   * @return With `block` set, whether the worker waited in the poller;
+   * otherwise whether any events were dispatched.
+   */
+  bool poll(TaskQueue &own, bool block);
+
+  /**
+   * @brief Blocks until `done()` returns true, running pending tasks in the
+   * meantime so that waiting inside a task cannot deadlock the pool.
+   *
+   * @tparam Predicate The type of the completion check.
+   * @param done The completion check.
+   */
+  template <typename Predicate> void waitUntil(Predicate &&done);
+};
+
+template <typename... Args, typename F>
+[[nodiscard]] std::future<
+    std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+ThreadPool::submit(F &&f, Args &&... args) {
+  auto task = internal::Task(internal::bindFunctionToArguments(
+      std::forward<F>(f), std::forward<Args>(args)...));
+  auto future = task.get_future();
+  AdmissionPolicy const *policy =
+      admission_.load(std::memory_order_acquire);
+  if (policy && !admit(*policy, task)) {
+    return future;
+  }
+  externalPush(std::move(task), true);
+  return future;
+}
+
+template <typename... Args, typename F>
+[[nodiscard]] std::future<
+    std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+ThreadPool::submit_to(std::size_t worker, Affinity affinity, F &&f,
+                      Args &&... args) {
+  assert(worker < queues_.size());
+  auto task = internal::Task(internal::bindFunctionToArguments(
+      std::forward<F>(f), std::forward<Args>(args)...));
+  auto future = task.get_future();
+  pushAffine(worker, affinity, std::move(task));
+  return future;
+}
+
+inline void ThreadPool::pushAffine(std::size_t worker, Affinity affinity,
+                                   task_t task) {
+  ensureStarted();
+  TaskQueue &target = queues_[worker];
+  pending_task_count_.fetch_add(1, std::memory_order_relaxed);
+  (affinity == Affinity::Hard ? target.hard : target.soft)
+      .push(std::move(task));
+  notify(target);
+}
+
+template <std::invocable F>
+void ThreadPool::externalPush(F &&f, bool droppable, bool coalescable) {
+  ensureStarted();
+  std::size_t slot =
+      rotating_index_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+  TaskQueue &target = queues_[slot];
+  task_t task(std::forward<F>(f));
+  std::size_t coalesce =
+      coalescable ? coalesce_depth_.load(std::memory_order_relaxed) : 0;
+  {
+    /* Any thread may submit, but only one at a time may push to a deque. */
+    std::lock_guard lock(target.submit_mutex);
+    if (coalesce && target.dq.size() >= coalesce) {
+      if (target.batch && target.batch->append(task)) {
+        return;
+      }
+      /* Start a new batch. Its worker is busy with the tasks queued before
+       * it, so later tasks are likely to join it before it runs. */
+      target.batch = std::make_shared<Batch>();
+      target.batch->append(task);
+      pending_task_count_.fetch_add(1, std::memory_order_relaxed);
+      target.dq.push(task_t([batch = target.batch] {
+                       std::uint32_t n = batch->close();
+                       for (std::uint32_t i = 0; i < n; ++i) {
+                         ++tasks_started_;
+                         std::invoke(std::move(batch->tasks[i]));
+                       }
+                     }),
+                     false);
+    } else {
+      target.batch.reset();
+      pending_task_count_.fetch_add(1, std::memory_order_relaxed);
+      target.dq.push(std::move(task), droppable);
+    }
+  }
+  notify(target);
+}
+
+template <typename T>
+bool ThreadPool::admit(AdmissionPolicy const &policy, T &task) {
+  std::size_t depth = queued();
+  if (policy.max_queued && depth >= policy.max_queued) {
+    switch (policy.overflow) {
+    case Overflow::Block:
+      waitForRoom();
+      break;
+    case Overflow::Reject:
+      throw QueueFullError("ThreadPool queue is full");
+    case Overflow::CallerRuns:
+      std::invoke(std::move(task));
+      return false;
+    case Overflow::DropOldest:
+      dropOldest();
+      break;
+    }
+  }
+  if (policy.high_watermark && depth + 1 >= policy.high_watermark &&
+      !above_high_.load(std::memory_order_relaxed) &&
+      !above_high_.exchange(true, std::memory_order_relaxed) &&
+      policy.on_high) {
+    policy.on_high(depth + 1);
+  }
+  return true;
+}
+
+inline void ThreadPool::waitForRoom() {
+  auto has_room = [this] {
+    AdmissionPolicy const *policy = admission_.load(std::memory_order_acquire);
+    return !policy || !policy->max_queued || queued() < policy->max_queued;
+  };
+  if (current_pool_ == this) {
+    waitUntil(has_room);
+    return;
+  }
+  /* Pairs with the fence in taskTaken(): either this thread sees the room, or
+   * the worker that made it sees this thread waiting. */
+  blocked_.fetch_add(1, std::memory_order_seq_cst);
+  while (!has_room()) {
+    room_.wait();
+  }
+  blocked_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline void ThreadPool::dropOldest() {
+  std::size_t n = queues_.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    TaskQueue &q =
+        queues_[(rotating_index_.load(std::memory_order_relaxed) + i) % n];
+    /* Only the head of the deque is taken, like a thief would. */
+    while (std::optional<ExternalTask> oldest = q.dq.steal()) {
+      if (oldest->droppable) {
+        /* Destroying the task breaks its promise. */
+        taskTaken(pending_task_count_.fetch_sub(1, std::memory_order_release) -
+                  1);
+        return;
+      }
+      /* Spawned tasks belong to a TaskGroup, strand or job that waits for
+       * them. The worker checks its mailbox before the deque, so the task
+       * stays ahead of the tasks queued after it; it remains pending. */
+      q.soft.push(std::move(oldest->task));
+    }
+  }
+}
+
+inline void ThreadPool::taskTaken(std::int64_t depth) {
+  AdmissionPolicy const *policy = admission_.load(std::memory_order_acquire);
+  if (!policy) {
+    return;
+  }
+  if (policy->max_queued) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (blocked_.load(std::memory_order_relaxed) > 0 &&
+        depth < static_cast<std::int64_t>(policy->max_queued)) {
+      room_.signal();
+    }
+  }
+  if (depth <= static_cast<std::int64_t>(policy->low_watermark) &&
+      above_high_.load(std::memory_order_relaxed) &&
+      above_high_.exchange(false, std::memory_order_relaxed) &&
+      policy->on_low) {
+    policy->on_low(
+        static_cast<std::size_t>(std::max<std::int64_t>(0, depth)));
+  }
+}
+
+template <std::invocable F> void ThreadPool::spawn(F &&f) {
+  if (current_pool_ != this) {
+    externalPush(std::forward<F>(f));
+    return;
+  }
+  pending_task_count_.fetch_add(1, std::memory_order_seq_cst);
+  queues_[current_id_].local.push(std::forward<F>(f));
+  std::size_t threshold = surplus_threshold_.load(std::memory_order_relaxed);
+  if (threshold && queues_[current_id_].local.size() > threshold &&
+      shareSurplus(current_id_)) {
+    return;
+  }
+  /* A searching worker will find the task. If there is none, wake a parked
+   * worker to steal it in case this worker does not get to it first. */
+  if (searching_count_.load(std::memory_order_seq_cst) == 0) {
+    wakeParkedWorker();
+  }
+}
+
+inline void ThreadPool::pushContinuation(std::coroutine_handle<> continuation) {
+  assert(current_pool_ == this);
+  pending_task_count_.fetch_add(1, std::memory_order_seq_cst);
+  queues_[current_id_].continuations.push(continuation);
+  if (searching_count_.load(std::memory_order_seq_cst) == 0) {
+    wakeParkedWorker();
+  }
+}
+
+inline bool
+ThreadPool::popContinuation(std::coroutine_handle<> continuation) {
+  if (current_pool_ != this) {
+    return false;
+  }
+  /* Thieves take the oldest entries first, so if the continuation is still in
+   * this deque it is the newest entry: everything pushed after it belonged to
+   * jobs that have finished. */
+  Deque<std::coroutine_handle<>> &own = queues_[current_id_].continuations;
+  std::optional<std::coroutine_handle<>> newest = own.pop();
+  if (!newest) {
+    return false;
+  }
+  if (*newest != continuation) {
+    own.push(*newest);
+    return false;
+  }
+  taskTaken(pending_task_count_.fetch_sub(1, std::memory_order_release) - 1);
+  return true;
+}
+
+inline void ThreadPool::requeue(std::coroutine_handle<> h) {
+  assert(current_pool_ == this);
+  pending_task_count_.fetch_add(1, std::memory_order_seq_cst);
+  /* Only the worker pushes to this deque, and both it and thieves take the
+   * oldest entry. The worker looks at it after its external deque, so
+   * everything else it holds runs first. */
+  queues_[current_id_].yielded.push(h);
+  if (searching_count_.load(std::memory_order_seq_cst) == 0) {
+    wakeParkedWorker();
+  }
+}
+
+inline bool ThreadPool::shouldYield() {
+  /* Nobody else can run tasks with hard affinity to this worker. */
+  if (!queues_[current_id_].hard.empty()) {
+    return true;
+  }
+  if (slice_task_ != tasks_started_) {
+    slice_task_ = tasks_started_;
+    slice_start_ = std::chrono::steady_clock::now();
+    return false;
+  }
+  return pending_task_count_.load(std::memory_order_relaxed) > 0 &&
+         std::chrono::steady_clock::now() - slice_start_ >= YIELD_SLICE;
+}
+
+inline void ThreadPool::ensureStarted() {
+  if (!start_requested_.load(std::memory_order_acquire) &&
+      !start_requested_.exchange(true, std::memory_order_acq_rel)) {
+    startWorker(0);
+  }
+  throwIfStartFailed();
+}
+
+inline void ThreadPool::waitStarted() {
+  ensureStarted();
+  while (started_count_.load(std::memory_order_acquire) +
+             failed_count_.load(std::memory_order_acquire) <
+         threads_.size()) {
+    std::this_thread::yield();
+  }
+  throwIfStartFailed();
+}
+
+inline void ThreadPool::throwIfStartFailed() {
+  if (failed_count_.load(std::memory_order_acquire) > 0) {
+    std::lock_guard lock(start_mutex_);
+    std::rethrow_exception(start_error_);
+  }
+}
+
+inline void ThreadPool::startWorker(std::size_t id) noexcept {
+  std::size_t stack_size = worker_options_.stack_size;
+  if (stack_size) {
+    stack_size = std::max(stack_size, MIN_STACK_BYTES);
+  }
+  try {
+    threads_[id] = internal::Thread(
+        stack_size, [this, id] { workerMain(stop_.get_token(), id); });
+  } catch (...) {
+    {
+      std::lock_guard lock(start_mutex_);
+      if (!start_error_) {
+        start_error_ = std::current_exception();
+      }
+    }
+    failed_count_.fetch_add(1, std::memory_order_release);
+    /* The worker cannot start its children; keep the startup tree going so
+     * that every slot is accounted for. */
+    for (std::size_t child = 2 * id + 1;
+         child <= 2 * id + 2 && child < queues_.size(); ++child) {
+      startWorker(child);
+    }
+    return;
+  }
+  started_count_.fetch_add(1, std::memory_order_release);
+}
+
+inline void ThreadPool::workerMain(std::stop_token token, std::size_t id) {
+  /* Start this worker's children in the startup tree. */
+  for (std::size_t child = 2 * id + 1;
+       child <= 2 * id + 2 && child < queues_.size(); ++child) {
+    startWorker(child);
+  }
+
+  WorkerOptions const &options = worker_options_;
+  internal::configureThread(options.name.empty()
+                                ? std::string()
+                                : options.name + "-" + std::to_string(id),
+                            options.policy, options.priority, options.nice);
+
+  /* Gives each worker its own random sequence for picking victims. */
+  prng::seed(id + 1);
+  current_pool_ = this;
+  current_id_ = id;
+  if (options.on_start) {
+    options.on_start(id);
+  }
+  TaskQueue &own = queues_[id];
+  do {
+    /* Wait for task to pushed and worker to be signaled. */
+    own.parked.store(true, std::memory_order_relaxed);
+    if (!poll(own, true)) {
+      own.sem.wait();
+    }
+    own.parked.store(false, std::memory_order_relaxed);
+    std::size_t spin_count = 0;
+    while (true) {
+      if (!runPendingTask(id, spin_count++) && spin_count > SPIN_LIMIT &&
+          !own.searching && !token.stop_requested() && !poll(own, false)) {
+        /* The own deques are empty and enough workers are searching already.
+         * Park until one of them finds work and hands the search over. Once
+         * the pool is stopping, keep going until all tasks are finished, as
+         * nobody would wake this worker again. */
+        break;
+      }
+
+      /* Work until all tasks are finished */
+      if (pending_task_count_.load(std::memory_order_acquire) > 0) {
+        continue;
+      }
+      /* Leaving the searching workers races with spawn(), which does not wake
+       * anyone while a worker is searching; check once more afterwards. */
+      if (!stopSearching(id) ||
+          pending_task_count_.load(std::memory_order_seq_cst) == 0) {
+        break;
+      }
+    }
+    /* A parked fiber is resumed on this worker once it is woken, even if the
+     * pool is stopping. */
+  } while (!token.stop_requested() || own.fibers > 0);
+  if (options.on_stop) {
+    options.on_stop(id);
+  }
+}
+
+inline void ThreadPool::prewarm() {
+  assert(current_pool_ != this && "prewarm() called from a worker");
+  /* Fail before pushing any task that refers to this frame. */
+  waitStarted();
+  /* One task per worker, each blocking until all have arrived, so that every
+   * worker runs exactly one of them. They must not be coalesced, as a task
+   * behind another one in a batch could never arrive. */
+  std::latch arrived(static_cast<std::ptrdiff_t>(queues_.size()));
+  std::atomic<std::size_t> done = 0;
+  for (std::size_t i = 0; i < queues_.size(); ++i) {
+    externalPush([&arrived, &done] {
+      char stack[PREWARM_STACK_BYTES];
+      volatile char *touch = stack;
+      for (std::size_t b = 0; b < PREWARM_STACK_BYTES; b += 4096) {
+        touch[b] = 0;
+      }
+          arrived.arrive_and_wait();
+          done.fetch_add(1, std::memory_order_release);
+        },
+        false, false);
+  }
+  /* Spin rather than wait on the latch, so that no task can still be using
+   * the latch when it goes out of scope. */
+  while (done.load(std::memory_order_acquire) < queues_.size()) {
+    std::this_thread::yield();
+  }
+}
+
+template <typename T> void ThreadPool::wait(std::future<T> const &future) {
+  waitUntil([&future] {
+    return future.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+  });
+}
+
+inline bool ThreadPool::runPendingTask(std::size_t id, std::size_t attempt) {
+  TaskQueue &own = queues_[id];
+  std::optional<task_t> fetched_task = own.local.pop();
+  if (own.advertised) {
+    retractSurplus(id);
+  }
+  if (!fetched_task) {
+    /* A continuation left behind by a job that is blocked elsewhere. */
+    if (auto continuation = own.continuations.pop()) {
+      taskTaken(pending_task_count_.fetch_sub(1, std::memory_order_release) -
+                1);
+      runTask([h = *continuation] { h.resume(); });
+      return true;
+    }
+    /* Tasks submitted to this worker come before the shared ones. */
+    if (std::optional<task_t> task = own.hard.take()) {
+      taskTaken(pending_task_count_.fetch_sub(1, std::memory_order_release) -
+                1);
+      runTask(std::move(*task));
+      return true;
+    }
+    fetched_task = own.soft.take();
+  }
+  if (!fetched_task) {
+    /* Decide whether to work on one's own queue or from a random worker. */
+    if (attempt >= SPIN_LIMIT && own.dq.empty() && own.yielded.empty()) {
+      return searchPendingTask(id);
+    }
+    if (std::optional<ExternalTask> external = own.dq.steal()) {
+      fetched_task = std::move(external->task);
+    } else if (auto yielded = own.yielded.steal()) {
+      fetched_task = task_t([h = *yielded] { h.resume(); });
+    }
+  }
+  if (!fetched_task) {
+    return false;
+  }
+  taskTaken(pending_task_count_.fetch_sub(1, std::memory_order_release) - 1);
+  runTask(std::move(*fetched_task));
+  return true;
+}
+
+template <typename F> void ThreadPool::runTask(F &&f) {
+  ++tasks_started_;
+  if (current_pool_ != this) {
+    std::invoke(std::forward<F>(f));
+    return;
+  }
+  /* Only this worker writes its heartbeat, so plain loads and stores do. */
+  Heartbeat &beat = queues_[current_id_].heartbeat;
+  std::uint32_t depth = beat.depth.load(std::memory_order_relaxed);
+  char const *outer_tag = beat.tag.load(std::memory_order_relaxed);
+  beat.tasks.store(beat.tasks.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  beat.depth.store(depth + 1, std::memory_order_relaxed);
+  if (outer_tag) {
+    beat.tag.store(nullptr, std::memory_order_relaxed);
+  }
+  std::invoke(std::forward<F>(f));
+  beat.depth.store(depth, std::memory_order_relaxed);
+  if (outer_tag || beat.tag.load(std::memory_order_relaxed)) {
+    beat.tag.store(outer_tag, std::memory_order_relaxed);
+  }
+}
+
+inline bool ThreadPool::stealPendingTask(std::size_t slot) {
+  std::optional<task_t> fetched_task = stealFrom(slot);
+  if (!fetched_task) {
+    return false;
+  }
+  taskTaken(pending_task_count_.fetch_sub(1, std::memory_order_release) - 1);
+  runTask(std::move(*fetched_task));
+  return true;
+}
+
+inline std::optional<ThreadPool::task_t>
+ThreadPool::stealFrom(std::size_t slot) {
+  TaskQueue *thief = current_pool_ == this ? &queues_[current_id_] : nullptr;
+  auto bump = [](std::atomic<std::uint64_t> &counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+  };
+  auto attempt = [&](auto &dq) {
+    if (dq.empty()) {
+      return decltype(dq.steal()){};
+    }
+    if (thief) {
+      bump(thief->steal_attempts);
+    }
+    auto fetched = dq.steal();
+    if (!fetched && thief) {
+      bump(thief->failed_steals);
+    }
+    return fetched;
+  };
+  if (std::optional<ExternalTask> external = attempt(queues_[slot].dq)) {
+    return std::move(external->task);
+  }
+  /* Stealing a continuation takes the oldest, and thus largest, remaining
+   * part of a forked job. */
+  if (auto continuation = attempt(queues_[slot].continuations)) {
+    return task_t([h = *continuation] { h.resume(); });
+  }
+  if (std::optional<task_t> fetched_task = attempt(queues_[slot].local)) {
+    return fetched_task;
+  }
+  if (auto yielded = attempt(queues_[slot].yielded)) {
+    return task_t([h = *yielded] { h.resume(); });
+  }
+  /* Soft-affine tasks last, so that they stay with their worker while there
+   * is other work to steal. */
+  TaskQueue &victim = queues_[slot];
+  if (victim.soft.empty()) {
+    return std::nullopt;
+  }
+  if (thief) {
+    bump(thief->steal_attempts);
+  }
+  std::optional<task_t> fetched_task = victim.soft.take();
+  if (!fetched_task && thief) {
+    bump(thief->failed_steals);
+  }
+  return fetched_task;
+}
+
+inline bool ThreadPool::searchPendingTask(std::size_t id) {
+  TaskQueue &own = queues_[id];
+  if (!own.searching) {
+    std::size_t searching = searching_count_.load(std::memory_order_relaxed);
+    do {
+      if (searching >= max_searching_.load(std::memory_order_relaxed)) {
+        return false;
+      }
+    } while (!searching_count_.compare_exchange_weak(
+        searching, searching + 1, std::memory_order_seq_cst,
+        std::memory_order_relaxed));
+    own.searching = true;
+  }
+
+  std::optional<task_t> fetched_task;
+  if (surplus_threshold_.load(std::memory_order_relaxed)) {
+    if (std::optional<std::size_t> loaded = findSurplus()) {
+      fetched_task = stealFrom(*loaded);
+    }
+  }
+  if (!fetched_task) {
+    fetched_task = stealFrom(prng::next() % queues_.size());
+  }
+  if (!fetched_task) {
+    return false;
+  }
+
+  /* Found work. If this was the last searching worker and more work is
+   * pending, wake a parked worker to carry on searching. */
+  stopSearching(id);
+  std::int64_t depth =
+      pending_task_count_.fetch_sub(1, std::memory_order_seq_cst) - 1;
+  taskTaken(depth);
+  if (depth > 0 && searching_count_.load(std::memory_order_seq_cst) == 0) {
+    wakeParkedWorker();
+  }
+  runTask(std::move(*fetched_task));
+  return true;
+}
+
+inline bool ThreadPool::stopSearching(std::size_t id) {
+  TaskQueue &own = queues_[id];
+  if (!own.searching) {
+    return false;
+  }
+  own.searching = false;
+  searching_count_.fetch_sub(1, std::memory_order_seq_cst);
+  return true;
+}
+
+inline bool ThreadPool::shareSurplus(std::size_t id) {
+  TaskQueue &own = queues_[id];
+  if (!own.advertised) {
+    own.advertised = true;
+    surplus_[id / 64].fetch_or(std::uint64_t{1} << (id % 64),
+                               std::memory_order_relaxed);
+  }
+  if (!push_to_parked_.load(std::memory_order_relaxed) ||
+      searching_count_.load(std::memory_order_seq_cst) != 0) {
+    return false;
+  }
+  std::size_t n = queues_.size();
+  std::size_t start = prng::next() % n;
+  for (std::size_t i = 0; i < n; ++i) {
+    TaskQueue &candidate = queues_[(start + i) % n];
+    if (&candidate == &own ||
+        !candidate.parked.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    /* The oldest task is the one a thief would take; it stays counted as
+     * pending while it moves to the mailbox. */
+    std::optional<task_t> task = own.local.steal();
+    if (!task) {
+      return false;
+    }
+    candidate.soft.push(std::move(*task));
+    notify(candidate);
+    return true;
+  }
+  return false;
+}
+
+inline void ThreadPool::retractSurplus(std::size_t id) {
+  TaskQueue &own = queues_[id];
+  if (own.local.size() >
+      surplus_threshold_.load(std::memory_order_relaxed) / 2) {
+    return;
+  }
+  own.advertised = false;
+  surplus_[id / 64].fetch_and(~(std::uint64_t{1} << (id % 64)),
+                              std::memory_order_relaxed);
+}
+
+inline std::optional<std::size_t> ThreadPool::findSurplus() const noexcept {
+  std::size_t words = surplus_.size();
+  std::size_t start = prng::next() % words;
+  for (std::size_t i = 0; i < words; ++i) {
+    std::size_t w = (start + i) % words;
+    std::uint64_t bits = surplus_[w].load(std::memory_order_relaxed);
+    if (bits) {
+      /* Start at a random bit so that thieves spread over the loaded
+       * workers. */
+      int r = static_cast<int>(prng::next() % 64);
+      int b = (std::countr_zero(std::rotr(bits, r)) + r) % 64;
+      return w * 64 + static_cast<std::size_t>(b);
+    }
+  }
+  return std::nullopt;
+}
+
+inline void ThreadPool::wakeParkedWorker() {
+  std::size_t n = queues_.size();
+  std::size_t start = prng::next() % n;
+  for (std::size_t i = 0; i < n; ++i) {
+    TaskQueue &candidate = queues_[(start + i) % n];
+    if (candidate.parked.load(std::memory_order_relaxed)) {
+      notify(candidate);
+      return;
+    }
+  }
+}
+
+inline void ThreadPool::notify(TaskQueue &q) {
+  q.sem.signal();
+  /* Pairs with the fence in poll(): either the worker sees the signal before
+   * it waits in the poller, or this thread sees it waiting there. */
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!q.polling.load(std::memory_order_relaxed)) {
+    return;
+  }
+  poller_users_.fetch_add(1, std::memory_order_seq_cst);
+  if (Poller const *poller = poller_.load(std::memory_order_seq_cst)) {
+    poller->interrupt(poller->context);
+  }
+  poller_users_.fetch_sub(1, std::memory_order_release);
+}
+
+inline bool ThreadPool::poll(TaskQueue &own, bool block) {
+  if (!poller_.load(std::memory_order_relaxed) ||
+      polling_.load(std::memory_order_relaxed) ||
+      polling_.exchange(true, std::memory_order_acquire)) {
+    return false;
+  }
+  /* Counted as a user before loading the poller, so that ~Reactor waits for
+   * this worker to leave it. */
+  poller_users_.fetch_add(1, std::memory_order_seq_cst);
+  Poller const *poller = poller_.load(std::memory_order_seq_cst);
+  bool result = false;
+  if (poller && !block) {
+    result = poller->poll(poller->context, false);
+  } else if (poller) {
+    own.polling.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!own.sem.tryWait()) {
+      poller->poll(poller->context, true);
+      /* Consume the signal that may have ended the wait. */
+      own.sem.tryWait();
+    }
+    own.polling.store(false, std::memory_order_relaxed);
+    result = true;
+  }
+  poller_users_.fetch_sub(1, std::memory_order_release);
+  polling_.store(false, std::memory_order_release);
+  return result;
+}
+
+inline ThreadPool::Stats ThreadPool::stats() const noexcept {
+  Stats total{0, 0, searching_count_.load(std::memory_order_relaxed)};
+  for (auto const &q : queues_) {
+    total.steal_attempts += q.steal_attempts.load(std::memory_order_relaxed);
+    total.failed_steals += q.failed_steals.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+template <typename Predicate> void ThreadPool::waitUntil(Predicate &&done) {
+  /* A fiber parks instead, so that its small stack does not have to hold the
+   * tasks run in the meantime. Nothing wakes it when done() becomes true, so
+   * it has the timer wake it after a growing delay to check again; the worker
+   * runs other tasks, or parks itself, in between. */
+  if (internal::FiberContext const *fiber = internal::current_fiber) {
+    std::chrono::microseconds delay = FIBER_POLL_MIN;
+    while (!done()) {
+      internal::Timer::global().schedule(
+          internal::Timer::clock::now() + delay,
+          [waker = fiber->waker] { waker(); });
+      fiber->park();
+      delay = std::min(2 * delay, FIBER_POLL_MAX);
+    }
+    return;
+  }
+  if (current_pool_ == this) {
+    for (std::size_t attempt = 0; !done(); ++attempt) {
+      /* What the task waits for may be the readiness of a file descriptor. */
+      if (!runPendingTask(current_id_, attempt) && attempt >= SPIN_LIMIT) {
+        poll(queues_[current_id_], false);
+      }
+    }
+    /* Hand the search over if this worker was searching while it waited. */
+    if (stopSearching(current_id_) &&
+        pending_task_count_.load(std::memory_order_seq_cst) > 0) {
+      wakeParkedWorker();
+    }
+    return;
+  }
+  /* A thread outside the pool cannot own a deque, but it can still steal. */
+  for (std::size_t attempt = 0; !done(); ++attempt) {
+    if (!stealPendingTask(attempt % queues_.size())) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+/**
+ * @brief A group of tasks spawned on a ThreadPool that can be waited for
+ * together, for fork-join parallelism.
+ *
+ * Tasks added with run() are spawned onto the calling worker's local deque, so
+ * a recursive algorithm that forks at every level keeps its subproblems close
+ * to the worker and lets idle workers steal the largest ones. wait() runs other
+ * pending tasks instead of blocking, so it is safe to call from inside a task.
+ *
+ * @note The TaskGroup must outlive the tasks it runs. The destructor waits for
+ * any tasks that are still running.
+ */
+class TaskGroup {
+public:
+  /**
+   * @brief Constructs an empty TaskGroup that spawns tasks on `pool`.
+   *
+   * @param pool The thread pool on which the tasks are run.
+   */
+  explicit TaskGroup(ThreadPool &pool) : pool_(pool) {}
+
+  /**
+   * @brief Constructs an empty TaskGroup that spawns tasks on this_pool().
+   */
+  TaskGroup();
+
+  TaskGroup(TaskGroup const &other) = delete;
+  TaskGroup &operator=(TaskGroup const &other) = delete;
+
+  /**
+   * @brief Spawns a task as part of the group.
+   *
+   * @tparam F The type of the task function.
+   * @param f The task function to be executed.
+   */
+  template <std::invocable F> void run(F &&f) {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    pool_.spawn([this, f = internal::decay_copy(std::forward<F>(f))]() mutable {
+      try {
+        std::invoke(std::move(f));
+      } catch (...) {
+        if (!failed_.test_and_set(std::memory_order_relaxed)) {
+          exception_ = std::current_exception();
+        }
+      }
+      pending_.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  /**
+   * @brief Waits for all tasks of the group to finish.
+   *
+   * If any task exited with an exception, the first such exception is rethrown
+   * once all tasks have finished.
+   */
+  void wait() {
+    pool_.waitUntil(
+        [this] { return pending_.load(std::memory_order_acquire) == 0; });
+    if (exception_) {
+      std::rethrow_exception(std::exchange(exception_, nullptr));
+    }
+  }
+
+  /**
+   * @brief Destructor. Waits for the tasks that are still running and discards
+   * their exceptions.
+   */
+  ~TaskGroup() {
+    pool_.waitUntil(
+        [this] { return pending_.load(std::memory_order_acquire) == 0; });
+  }
+
+private:
+  ThreadPool &pool_;                      // Pool on which the tasks run
+  std::atomic<std::int64_t> pending_{0};  // Number of unfinished tasks
+  std::atomic_flag failed_;               // Set by the first failing task
+  std::exception_ptr exception_;          // Exception of the first failure
+};
+
+/**
+ * @brief Returns the process-wide default thread pool.
+ *
+ * The pool is started on first use and runs recommended_concurrency()
+ * workers.
+ * Libraries that want parallelism without owning threads should use this pool
+ * (or this_pool()) instead of constructing their own, so that the machine is
+ * not oversubscribed.
+ */
+inline ThreadPool &default_pool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+/**
+ * @brief Returns the pool that parallel work started by the calling thread
+ * should use: the pool running the caller when called from a worker, and the
+ * default pool otherwise.
+ *
+ * Nested parallel constructs use this to spawn into the pool they are already
+ * running on instead of blocking a worker or starting more threads.
+ */
+inline ThreadPool &this_pool() {
+  ThreadPool *pool = ThreadPool::current();
+  return pool ? *pool : default_pool();
+}
+
+inline TaskGroup::TaskGroup() : pool_(this_pool()) {}
+
+namespace internal {
+
+/**
+ * @brief Gives this_task access to the scheduler of ThreadPool.
+ */
+struct TaskAccess {
+  static void requeue(ThreadPool &pool, std::coroutine_handle<> h) {
+    pool.requeue(h);
+  }
+
+  static bool shouldYield(ThreadPool &pool) { return pool.shouldYield(); }
+
+  static void setTag(ThreadPool &pool, char const *tag) {
+    pool.queues_[ThreadPool::current_worker()].heartbeat.tag.store(
+        tag, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief Awaiter of this_task::yield().
+ */
+struct YieldAwaiter {
+  ThreadPool *pool = ThreadPool::current();
+
+  bool await_ready() const noexcept { return !pool; }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    TaskAccess::requeue(*pool, h);
+  }
+
+  void await_resume() const noexcept {}
+};
+
+} // namespace internal
+
+/**
+ * @brief Cooperative scheduling for tasks that run for a long time.
+ *
+ * A worker runs each task to completion, so a few long tasks can occupy every
+ * worker while short ones wait behind them. Long tasks should check
+ * should_yield() at convenient points and, when it returns true, give up the
+ * worker: a coroutine by awaiting yield(), a plain task by saving its progress
+ * and spawning its remainder.
+ */
+namespace this_task {
+
+/**
+ * @brief Returns an awaitable that suspends the awaiting coroutine and queues
+ * it behind all work already waiting on the current worker.
+ *
+ * Other workers may steal the coroutine, so it may resume on a different
+ * worker. Outside a pool, awaiting the result does nothing.
+ */
+inline internal::YieldAwaiter yield() noexcept { return {}; }
+
+/**
+ * @brief Returns true if the calling task should give up its worker.
+ *
+ * That is the case when a task with hard affinity to the calling worker is
+ * waiting, which no other worker can run, or when other tasks are waiting and
+ * the calling task has run for ThreadPool::YIELD_SLICE since its first check.
+ * Always false outside a pool. Cheap enough to call in an inner loop.
+ */
+inline bool should_yield() {
+  ThreadPool *pool = ThreadPool::current();
+  return pool && internal::TaskAccess::shouldYield(*pool);
+}
+
+/**
+ * @brief Labels the task running on the calling worker, e.g. with the name of
+ * the job it belongs to. A Watchdog includes the tag when it reports the task.
+ * The tag is cleared when the task ends. Does nothing outside a pool.
+ *
+ * @param tag A string that outlives the task, such as a string literal.
+ */
+inline void set_tag(char const *tag) noexcept {
+  if (ThreadPool *pool = ThreadPool::current()) {
+    internal::TaskAccess::setTag(*pool, tag);
+  }
+}
+
+} // namespace this_task
+
+inline ThreadPool::~ThreadPool() {
+  /* Workers may still be launching their children. */
+  if (start_requested_.load(std::memory_order_acquire)) {
+    while (started_count_.load(std::memory_order_acquire) +
+               failed_count_.load(std::memory_order_acquire) <
+           threads_.size()) {
+      std::this_thread::yield();
+    }
+  }
+  stop_.request_stop();
+  for (auto &d : queues_) {
+    notify(d);
+  }
+  /* Join here rather than in the members' destructors, since the workers use
+   * members declared after threads_. */
+  for (auto &t : threads_) {
+    if (t.joinable()) {
+      t.join();
+    }
   }
 }
 } // namespace async
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include <async/threadpool.h>
+
+namespace async {
+
+namespace internal {
+
+/* How long a replacement worker sleeps after it found nothing to steal. */
+inline constexpr std::chrono::microseconds REPLACEMENT_BACKOFF{100};
+
+/**
+ * @brief Gives the watchdog access to the heartbeats of ThreadPool.
+ */
+struct WatchdogAccess {
+  struct Sample {
+    std::uint64_t tasks;
+    std::uint32_t depth;
+    char const *tag;
+  };
+
+  static Sample sample(ThreadPool const &pool, std::size_t worker) {
+    auto const &beat = pool.queues_[worker].heartbeat;
+    return {beat.tasks.load(std::memory_order_relaxed),
+            beat.depth.load(std::memory_order_relaxed),
+            beat.tag.load(std::memory_order_relaxed)};
+  }
+
+  static bool stealPendingTask(ThreadPool &pool, std::size_t slot) {
+    return pool.stealPendingTask(slot);
+  }
+};
+
+} // namespace internal
+
+/**
+ * @brief A task that has kept a worker busy for longer than the threshold.
+ */
+struct StallReport {
+  std::size_t worker;               // Index of the worker running the task
+  std::chrono::nanoseconds running; // How long the task has run, at least
+  char const *tag;                  // Set with this_task::set_tag(), or null
+};
+
+/**
+ * @brief Settings of a Watchdog.
+ */
+struct WatchdogOptions {
+  /* How long a task may run before it is reported. */
+  std::chrono::milliseconds threshold{1000};
+  /* How often the workers are sampled; 0 picks a quarter of the threshold. */
+  std::chrono::milliseconds interval{0};
+  /* Whether to start a replacement worker for each stalled worker. */
+  bool elastic = false;
+  /* Called on the watchdog thread, once per stalled task. */
+  std::function<void(StallReport const &)> on_stall = {};
+};
+
+/**
+ * @brief Watches the workers of a ThreadPool for tasks that run for too long,
+ * such as tasks that deadlocked or loop forever.
+ *
+ * Every worker counts the tasks it starts and keeps the tag of the running
+ * task in a heartbeat on a cache line of its own, which costs a few stores per
+ * task and no atomic read-modify-write. A watchdog thread samples the
+ * heartbeats every `interval`; a worker whose count has not moved while it was
+ * running a task for `threshold` is reported once through `on_stall`.
+ *
+ * The stalled worker's queued tasks remain stealable, but only while some
+ * other worker is idle. In elastic mode the watchdog therefore also starts a
+ * replacement thread for each stalled worker, which steals and runs tasks
+ * from the pool until the stalled task finishes. Tasks with hard affinity to
+ * the stalled worker still wait for it.
+ *
+ * @note The watchdog must be destroyed before its pool. The destructor waits
+ * for the tasks that replacement threads are running.
+ */
+class Watchdog {
+public:
+  /**
+   * @brief Starts watching `pool`.
+   *
+   * @param pool The pool to watch.
+   * @param options The threshold, sampling interval, mode and callback.
+   */
+  Watchdog(ThreadPool &pool, WatchdogOptions options)
+      : pool_(pool), options_(std::move(options)), workers_(pool.size()) {
+    if (options_.interval.count() == 0) {
+      options_.interval = std::max(std::chrono::milliseconds(1),
+                                   options_.threshold / 4);
+    }
+    thread_ = std::jthread([this](std::stop_token token) { watch(token); });
+  }
+
+  Watchdog(Watchdog const &other) = delete;
+  Watchdog &operator=(Watchdog const &other) = delete;
+
+  /**
+   * @brief Returns the number of workers found stalled at the last sample.
+   */
+  std::size_t stalled() const noexcept {
+    return stalled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns the number of replacement workers started so far.
+   */
+  std::size_t replacements() const noexcept {
+    return replacements_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Destructor. Stops the watchdog and its replacement workers.
+   */
+  ~Watchdog() { thread_.request_stop(); }
+
+private:
+  /**
+   * @brief What the watchdog knows about one worker.
+   */
+  struct Worker {
+    std::uint64_t tasks = 0; // Task count at the last sample
+    bool reported = false;   // Whether the running task was reported
+    std::chrono::steady_clock::time_point since; // When the count last moved
+
+    /* Thread standing in for the worker while it is stalled. */
+    std::jthread replacement;
+    std::atomic<bool> replacement_done = false;
+  };
+
+  ThreadPool &pool_;
+  WatchdogOptions options_;
+  std::vector<Worker> workers_;
+  std::atomic<std::size_t> stalled_ = 0;
+  std::atomic<std::size_t> replacements_ = 0;
+  std::mutex mutex_;                 // Guards nothing; needed by wake_
+  std::condition_variable_any wake_; // Sleeps until a stop is requested
+  std::jthread thread_;              // Declared last, so it stops first
+
+  void watch(std::stop_token token) {
+    std::unique_lock lock(mutex_);
+    while (true) {
+      wake_.wait_for(lock, token, options_.interval, [] { return false; });
+      if (token.stop_requested()) {
+        return;
+      }
+      sample();
+    }
+  }
+
+  void sample() {
+    auto now = std::chrono::steady_clock::now();
+    std::size_t stalled = 0;
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+      Worker &w = workers_[i];
+      if (w.replacement.joinable() &&
+          w.replacement_done.load(std::memory_order_acquire)) {
+        w.replacement.join();
+      }
+      internal::WatchdogAccess::Sample beat =
+          internal::WatchdogAccess::sample(pool_, i);
+      if (beat.depth == 0 || beat.tasks != w.tasks) {
+        w.tasks = beat.tasks;
+        w.since = now;
+        w.reported = false;
+        continue;
+      }
+      auto running = now - w.since;
+      if (running < options_.threshold) {
+        continue;
+      }
+      ++stalled;
+      if (!w.reported) {
+        w.reported = true;
+        if (options_.on_stall) {
+          options_.on_stall({i, running, beat.tag});
+        }
+      }
+      if (options_.elastic && !w.replacement.joinable()) {
+        startReplacement(i, beat.tasks);
+      }
+    }
+    stalled_.store(stalled, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Starts a thread that runs pool tasks for as long as worker `i` is
+   * stuck in the task it started as its `tasks`-th.
+   */
+  void startReplacement(std::size_t i, std::uint64_t tasks) {
+    Worker &w = workers_[i];
+    w.replacement_done.store(false, std::memory_order_relaxed);
+    replacements_.fetch_add(1, std::memory_order_relaxed);
+    w.replacement = std::jthread([this, &w, i, tasks](std::stop_token token) {
+      auto stuck = [&] {
+        internal::WatchdogAccess::Sample beat =
+            internal::WatchdogAccess::sample(pool_, i);
+        return beat.depth > 0 && beat.tasks == tasks;
+      };
+      for (std::size_t slot = 0; !token.stop_requested() && stuck(); ++slot) {
+        if (!internal::WatchdogAccess::stealPendingTask(
+                pool_, slot % pool_.size())) {
+          std::this_thread::sleep_for(internal::REPLACEMENT_BACKOFF);
+        }
+      }
+      w.replacement_done.store(true, std::memory_order_release);
+    });
+  }
+};
+
+} // namespace async
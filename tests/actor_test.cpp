@@ -0,0 +1,50 @@
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "async/actor.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("actor.TellAsk" * doctest::timeout(25)) {
+  async::ThreadPool pool(4);
+  async::Actor<long> counter(pool, 0);
+  {
+    std::vector<std::jthread> senders;
+    for (int t = 0; t < 4; t++) {
+      senders.emplace_back([&] {
+        for (int i = 0; i < 10000; i++) {
+          counter.tell([](long &n) { n++; });
+        }
+      });
+    }
+  }
+  REQUIRE(counter.ask([](long &n) { return n; }).get() == 40000);
+
+  auto error =
+      counter.ask([](long &) -> int { throw std::runtime_error("actor"); });
+  REQUIRE_THROWS_AS(error.get(), std::runtime_error);
+}
+
+TEST_CASE("actor.ManyActors" * doctest::timeout(25)) {
+  async::ThreadPool pool(4);
+  std::vector<std::unique_ptr<async::Actor<std::vector<int>>>> actors;
+  for (int a = 0; a < 1000; a++) {
+    actors.push_back(std::make_unique<async::Actor<std::vector<int>>>(pool));
+  }
+  /* Messages sent from tasks to other actors, in order per actor. */
+  pool.submit([&] {
+        for (int i = 0; i < 100; i++) {
+          for (auto &actor : actors) {
+            actor->tell([i](std::vector<int> &seen) { seen.push_back(i); });
+          }
+        }
+      }).get();
+  for (auto &actor : actors) {
+    auto seen = actor->ask([](std::vector<int> &s) { return s; }).get();
+    REQUIRE(seen.size() == 100);
+    for (int i = 0; i < 100; i++) {
+      REQUIRE(seen[i] == i);
+    }
+  }
+}
@@ -0,0 +1,182 @@
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <forward_list>
+#include <list>
+#include <numeric>
+#include <vector>
+
+#include "async/algorithm.h"
+#include "doctest/doctest.h"
+
+static const async::Partitioning partitionings[] = {
+    async::Partitioning::Static, async::Partitioning::Dynamic,
+    async::Partitioning::Adaptive, async::Partitioning::Auto};
+
+TEST_CASE("algorithm.ParallelFor") {
+  async::ThreadPool pool(4);
+  for (auto partitioning : partitionings) {
+    for (std::size_t grain : {0, 1, 7, 1000}) {
+      std::vector<std::atomic<int>> hits(10000);
+      async::parallel_for(
+          pool, 0, 10000, [&](int i) { hits[i]++; }, {grain, partitioning});
+      for (auto &h : hits) {
+        REQUIRE(h == 1);
+      }
+    }
+  }
+}
+
+/* Visits every index of [first, last) and checks each was visited once. */
+template <typename I> void checkIndexRange(async::ThreadPool &pool, I first,
+                                           I last) {
+  std::vector<std::atomic<int>> hits(
+      static_cast<std::size_t>(static_cast<long long>(last) - first));
+  async::parallel_for(pool, first, last, [&](I i) {
+    hits[static_cast<std::size_t>(static_cast<long long>(i) - first)]++;
+  });
+  for (auto &h : hits) {
+    REQUIRE(h == 1);
+  }
+}
+
+TEST_CASE("algorithm.ParallelForWideRange") {
+  async::ThreadPool pool(4);
+  /* Ranges longer than the largest value of the index type. */
+  checkIndexRange<signed char>(pool, SCHAR_MIN, SCHAR_MAX);
+  checkIndexRange<short>(pool, SHRT_MIN, SHRT_MAX);
+  checkIndexRange<int>(pool, INT_MIN, INT_MIN + 1000);
+  checkIndexRange<int>(pool, INT_MAX - 1000, INT_MAX);
+}
+
+TEST_CASE("algorithm.AutoGrain") {
+  async::ThreadPool pool(4);
+  async::LoopPolicy policy{0, async::Partitioning::Auto};
+
+  /* Counts the chunks of a loop over `n` iterations that each take `cost`.
+   * Every `Site` makes a body of a different type, which gets a tuner of its
+   * own even though the call is on the same line. */
+  auto chunks = [&]<int Site>(std::size_t n, std::chrono::nanoseconds cost) {
+    std::atomic<std::size_t> count = 0;
+    async::internal::parallelChunks(
+        pool, n, policy, [&](std::size_t begin, std::size_t end) {
+          count++;
+          auto stop = std::chrono::steady_clock::now() + (end - begin) * cost;
+          while (std::chrono::steady_clock::now() < stop) {
+          }
+        });
+    return count.load();
+  };
+
+  /* The first call learns the cost; the second starts with a fitting grain,
+   * so cheap iterations are batched and expensive ones are not. */
+  for (int call = 0; call < 2; ++call) {
+    std::size_t cheap =
+        chunks.operator()<0>(1000000, std::chrono::nanoseconds(0));
+    std::size_t costly =
+        chunks.operator()<1>(200, std::chrono::microseconds(20));
+    if (call == 1) {
+      CHECK(cheap <= 1000000 / 100);
+      CHECK(costly >= 200 / 10);
+    }
+  }
+}
+
+TEST_CASE("algorithm.AutoGrainPerCallSite") {
+  async::ThreadPool pool(4);
+  async::LoopPolicy policy{0, async::Partitioning::Auto};
+
+  /* Both loops run a body of the same type; only their call sites differ. */
+  std::chrono::nanoseconds cost{0};
+  std::atomic<std::size_t> count = 0;
+  auto body = [&](std::size_t begin, std::size_t end) {
+    count++;
+    auto stop = std::chrono::steady_clock::now() + (end - begin) * cost;
+    while (std::chrono::steady_clock::now() < stop) {
+    }
+  };
+  for (int call = 0; call < 2; ++call) {
+    cost = std::chrono::nanoseconds(0);
+    count = 0;
+    async::internal::parallelChunks(pool, 1000000, policy, body);
+    std::size_t cheap = count.load();
+    cost = std::chrono::microseconds(20);
+    count = 0;
+    async::internal::parallelChunks(pool, 200, policy, body);
+    std::size_t costly = count.load();
+    if (call == 1) {
+      CHECK(cheap <= 1000000 / 100);
+      CHECK(costly >= 200 / 10);
+    }
+  }
+}
+
+TEST_CASE("algorithm.ForEachRandomAccess") {
+  async::ThreadPool pool(4);
+  for (auto partitioning : partitionings) {
+    std::vector<int> v(12345, 1);
+    async::for_each(pool, v, [](int &x) { x *= 3; }, {.partitioning = partitioning});
+    REQUIRE(std::accumulate(v.begin(), v.end(), 0) == 3 * 12345);
+  }
+}
+
+TEST_CASE("algorithm.ForEachForward") {
+  async::ThreadPool pool(4);
+  std::forward_list<int> l(5000, 2);
+  async::for_each(pool, l, [](int &x) { x += 1; }, {.grain = 64});
+  REQUIRE(std::accumulate(l.begin(), l.end(), 0) == 3 * 5000);
+
+  /* Views that are not sized */
+  std::atomic<int> sum = 0;
+  async::for_each(pool, std::views::iota(0) | std::views::take_while([](int i) {
+                          return i < 1000;
+                        }),
+                  [&](int i) { sum += i; });
+  REQUIRE(sum == 999 * 1000 / 2);
+}
+
+TEST_CASE("algorithm.Transform") {
+  async::ThreadPool pool(4);
+  std::vector<int> in(10000);
+  std::iota(in.begin(), in.end(), 0);
+
+  std::vector<long> out(in.size());
+  auto end = async::transform(pool, in, out.begin(),
+                              [](int x) { return long{x} * x; });
+  REQUIRE(end == out.end());
+  for (std::size_t i = 0; i < in.size(); i++) {
+    REQUIRE(out[i] == long(i) * long(i));
+  }
+
+  std::list<int> lin(in.begin(), in.end());
+  std::list<int> lout(lin.size());
+  async::transform(pool, lin, lout.begin(), [](int x) { return -x; },
+                   {.grain = 100});
+  REQUIRE(std::equal(lout.begin(), lout.end(), in.begin(),
+                     [](int a, int b) { return a == -b; }));
+}
+
+TEST_CASE("algorithm.NestedInsideTask") {
+  async::ThreadPool pool(2);
+  std::vector<int> v(1000, 1);
+  pool.submit([&] {
+        async::for_each(pool, v, [](int &x) { x = 2; });
+      }).get();
+  REQUIRE(std::accumulate(v.begin(), v.end(), 0) == 2000);
+}
+
+TEST_CASE("algorithm.NestedUsesCurrentPool" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  std::atomic<int> foreign = 0;
+  std::atomic<int> sum = 0;
+  pool.submit([&] {
+        async::parallel_for(0, 100, [&](int i) {
+          async::parallel_for(0, 10, [&](int j) {
+            foreign += async::ThreadPool::current() != &pool;
+            sum += i * 10 + j;
+          });
+        });
+      }).get();
+  REQUIRE(foreign == 0);
+  REQUIRE(sum == 999 * 1000 / 2);
+}
@@ -0,0 +1,97 @@
+#include "async/completion.h"
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+
+#include "doctest/doctest.h"
+
+TEST_CASE("completion.Drain" * doctest::timeout(25)) {
+  constexpr int N = 10000;
+  async::ThreadPool pool(4);
+  async::CompletionQueue<int> queue;
+  for (int i = 0; i < N; i++) {
+    queue.submit(pool, [i] { return i; });
+  }
+
+  /* An external loop that sleeps in poll() until results arrive. */
+  long sum = 0;
+  int received = 0, wakeups = 0;
+  while (received < N) {
+    pollfd pfd{queue.fd(), POLLIN, 0};
+    REQUIRE(poll(&pfd, 1, -1) == 1);
+    wakeups++;
+    received += static_cast<int>(queue.drain([&](int x) { sum += x; }));
+  }
+  REQUIRE(received == N);
+  REQUIRE(sum == long{N} * (N - 1) / 2);
+  REQUIRE(wakeups <= N);
+
+  /* Drained empty, the fd is no longer readable. */
+  pollfd pfd{queue.fd(), POLLIN, 0};
+  REQUIRE(poll(&pfd, 1, 0) == 0);
+}
+
+/* Returns the counter of eventfd `fd`, as the kernel reports it in fdinfo
+ * (in hexadecimal), or -1 if it does not. */
+long long eventfdCount(int fd) {
+  std::ifstream info("/proc/self/fdinfo/" + std::to_string(fd));
+  std::string line;
+  while (std::getline(info, line)) {
+    if (line.rfind("eventfd-count:", 0) == 0) {
+      long long count = -1;
+      std::istringstream(line.substr(14)) >> std::hex >> count;
+      return count;
+    }
+  }
+  return -1;
+}
+
+TEST_CASE("completion.BurstSignalsOnce" * doctest::timeout(25)) {
+  constexpr int N = 1000;
+  async::ThreadPool pool(4);
+  async::CompletionQueue<int> queue;
+  std::atomic<int> posted = 0;
+  for (int i = 0; i < N; i++) {
+    pool.spawn([&queue, &posted, i] {
+      queue.post(i);
+      posted++;
+    });
+  }
+  while (posted < N) {
+    std::this_thread::yield();
+  }
+
+  /* The whole burst wrote to the eventfd once. */
+  long long count = eventfdCount(queue.fd());
+  REQUIRE((count == 1 || count == -1));
+  pollfd pfd{queue.fd(), POLLIN, 0};
+  REQUIRE(poll(&pfd, 1, 0) == 1);
+
+  /* One drain takes all of it and leaves nothing signaled. */
+  REQUIRE(queue.drain([](int) {}) == N);
+  REQUIRE(poll(&pfd, 1, 0) == 0);
+}
+
+TEST_CASE("completion.DrainMax") {
+  async::CompletionQueue<int> queue;
+  for (int i = 0; i < 10; i++) {
+    queue.post(i);
+  }
+  int last = -1;
+  REQUIRE(queue.drain([&](int x) { last = x; }, 4) == 4);
+  REQUIRE(last == 3);
+  /* The rest is still signaled. */
+  pollfd pfd{queue.fd(), POLLIN, 0};
+  REQUIRE(poll(&pfd, 1, 0) == 1);
+  REQUIRE(queue.drain([&](int x) { last = x; }) == 6);
+  REQUIRE(last == 9);
+}
+
+#endif
@@ -0,0 +1,47 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "async/concurrency.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("concurrency.Recommended") {
+  std::size_t n = async::recommended_concurrency();
+  REQUIRE(n >= 1);
+  REQUIRE(n <= std::max(1u, std::thread::hardware_concurrency()));
+}
+
+#if defined(__linux__)
+TEST_CASE("concurrency.CgroupFiles") {
+  /* A fresh directory, so that concurrent runs do not share files. */
+  std::string pattern =
+      (std::filesystem::temp_directory_path() / "async_cgroup_XXXXXX")
+          .string();
+  REQUIRE(mkdtemp(pattern.data()));
+  std::filesystem::path dir = pattern;
+  std::filesystem::create_directory(dir / "child");
+
+  auto write = [](std::filesystem::path const &path, char const *content) {
+    std::ofstream(path) << content;
+  };
+
+  /* cgroup v2 */
+  write(dir / "cpu.max", "max 100000\n");
+  REQUIRE(!async::internal::readCpuMax((dir / "cpu.max").string()));
+  write(dir / "cpu.max", "250000 100000\n");
+  REQUIRE(async::internal::readCpuMax((dir / "cpu.max").string()) == 3u);
+
+  /* cgroup v1, with a tighter quota on the parent than on the child */
+  write(dir / "cpu.cfs_quota_us", "200000\n");
+  write(dir / "cpu.cfs_period_us", "100000\n");
+  write(dir / "child" / "cpu.cfs_quota_us", "-1\n");
+  write(dir / "child" / "cpu.cfs_period_us", "100000\n");
+  REQUIRE(!async::internal::readCfsQuota((dir / "child").string()));
+  REQUIRE(async::internal::cgroupHierarchyLimit(
+              dir.string(), "/child", async::internal::readCfsQuota) == 2u);
+
+  std::filesystem::remove_all(dir);
+}
+#endif
@@ -0,0 +1,88 @@
+#include "async/fiber.h"
+
+#if ASYNC_FIBERS_SUPPORTED
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "async/mutex.h"
+#include "async/sem.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("fiber.BlockingWait" * doctest::timeout(25)) {
+  /* A single worker: the waiting fiber must step aside for the signaling one
+   * to run at all. */
+  async::ThreadPool pool(1);
+  async::LightweightSemaphore sem;
+  auto waiter = async::submit_fiber(pool, [&] {
+    sem.wait();
+    return 1;
+  });
+  auto signaler = async::submit_fiber(pool, [&] {
+    sem.signal();
+    return 2;
+  });
+  REQUIRE(waiter.get() + signaler.get() == 3);
+
+  /* Waiting for a future of the same pool. */
+  auto outer = async::submit_fiber(pool, [&pool] {
+    auto inner = pool.submit([] { return 42; });
+    pool.wait(inner);
+    return inner.get();
+  });
+  REQUIRE(outer.get() == 42);
+}
+
+TEST_CASE("fiber.Mutex" * doctest::timeout(25)) {
+  for (std::size_t nthreads : {1, 4}) {
+    async::ThreadPool pool(nthreads);
+    async::Mutex mutex;
+    async::LightweightSemaphore gate;
+    long counter = 0;
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < 200; i++) {
+      futures.push_back(async::submit_fiber(pool, [&, i] {
+        mutex.lock();
+        if (i == 0) {
+          /* Holds the lock until the last fiber opens the gate, so that the
+           * others pile up on the mutex. */
+          gate.wait();
+        }
+        ++counter;
+        mutex.unlock();
+      }));
+    }
+    futures.push_back(async::submit_fiber(pool, [&] { gate.signal(); }));
+    for (auto &future : futures) {
+      future.get();
+    }
+    REQUIRE(counter == 200);
+  }
+}
+
+TEST_CASE("fiber.ParkedWait" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  async::LightweightSemaphore sem;
+  std::promise<void> promise;
+  std::future<void> ready = promise.get_future();
+  auto on_sem = async::submit_fiber(pool, [&] { sem.wait(); });
+  auto on_future = async::submit_fiber(pool, [&] { pool.wait(ready); });
+
+  /* While the fibers wait, the worker parks instead of retrying the waits. */
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  std::clock_t start = std::clock();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  double cpu_ms = 1000.0 * static_cast<double>(std::clock() - start) /
+                  CLOCKS_PER_SEC;
+  sem.signal();
+  promise.set_value();
+  on_sem.get();
+  on_future.get();
+  REQUIRE(cpu_ms < 50);
+}
+
+#endif // ASYNC_FIBERS_SUPPORTED
@@ -0,0 +1,79 @@
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "async/graph.h"
+#include "doctest/doctest.h"
+
+using Edge = std::pair<std::uint32_t, std::uint32_t>;
+
+std::vector<std::int64_t> sequentialDepths(async::CsrGraph const &g,
+                                           std::uint32_t source) {
+  std::vector<std::int64_t> depth(g.vertices(), -1);
+  std::queue<std::uint32_t> q;
+  depth[source] = 0;
+  q.push(source);
+  while (!q.empty()) {
+    std::uint32_t u = q.front();
+    q.pop();
+    for (auto e = g.offsets[u]; e < g.offsets[u + 1]; e++) {
+      if (depth[g.neighbors[e]] == -1) {
+        depth[g.neighbors[e]] = depth[u] + 1;
+        q.push(g.neighbors[e]);
+      }
+    }
+  }
+  return depth;
+}
+
+/* Checks that `parent` is a valid BFS tree: every reached vertex hangs off a
+ * neighbor one level closer to the source. */
+void checkTree(async::CsrGraph const &g, std::uint32_t source,
+               std::vector<std::int64_t> const &parent) {
+  auto depth = sequentialDepths(g, source);
+  REQUIRE(parent[source] == source);
+  for (std::uint32_t v = 0; v < g.vertices(); v++) {
+    if (depth[v] == -1) {
+      REQUIRE(parent[v] == -1);
+    } else if (v != source) {
+      REQUIRE(parent[v] >= 0);
+      REQUIRE(depth[parent[v]] == depth[v] - 1);
+      bool adjacent = false;
+      for (auto e = g.offsets[v]; e < g.offsets[v + 1]; e++) {
+        adjacent |= g.neighbors[e] == parent[v];
+      }
+      REQUIRE(adjacent);
+    }
+  }
+}
+
+TEST_CASE("graph.BfsPath") {
+  /* A long path keeps the frontier small, so every step is top-down. */
+  std::vector<Edge> edges;
+  for (std::uint32_t v = 0; v + 1 < 1000; v++) {
+    edges.emplace_back(v, v + 1);
+  }
+  auto g = async::CsrGraph::fromEdges(1001, edges); /* Vertex 1000 isolated */
+
+  async::ThreadPool pool(4);
+  checkTree(g, 500, async::parallel_bfs(pool, g, 500));
+}
+
+TEST_CASE("graph.BfsRandom") {
+  /* A dense random graph has large frontiers that trigger bottom-up steps. */
+  std::mt19937 rng(42);
+  std::uint32_t n = 20000;
+  std::vector<Edge> edges;
+  for (std::size_t i = 0; i < 16 * n; i++) {
+    edges.emplace_back(rng() % n, rng() % n);
+  }
+  auto g = async::CsrGraph::fromEdges(n, edges);
+
+  async::ThreadPool pool(4);
+  for (std::uint32_t source : {0u, 1234u, n - 1}) {
+    checkTree(g, source, async::parallel_bfs(pool, g, source));
+  }
+}
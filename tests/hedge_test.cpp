@@ -0,0 +1,79 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+
+#include "async/hedge.h"
+#include "doctest/doctest.h"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("hedge.Straggler" * doctest::timeout(25)) {
+  async::ThreadPool pool(2);
+  std::atomic<int> attempts = 0;
+  std::atomic<bool> straggler_stopped = false;
+  auto result = async::submit_hedged(
+      pool,
+      [&](std::stop_token token) {
+        if (attempts++ == 0) {
+          /* The straggler: runs until the duplicate has won. */
+          while (!token.stop_requested()) {
+            std::this_thread::yield();
+          }
+          straggler_stopped = true;
+          return 1;
+        }
+        return 2;
+      },
+      10ms);
+  REQUIRE(result.get() == 2);
+  while (!straggler_stopped) {
+    std::this_thread::yield();
+  }
+  REQUIRE(attempts == 2);
+}
+
+TEST_CASE("hedge.NoDuplicateWhenFast" * doctest::timeout(25)) {
+  async::ThreadPool pool(2);
+  std::atomic<int> attempts = 0;
+  auto result = async::submit_hedged(
+      pool, [&] { return ++attempts; }, 20ms);
+  REQUIRE(result.get() == 1);
+  std::this_thread::sleep_for(60ms);
+  REQUIRE(attempts == 1);
+}
+
+TEST_CASE("hedge.Failure" * doctest::timeout(25)) {
+  async::ThreadPool pool(2);
+  auto result = async::submit_hedged(
+      pool, []() -> int { throw std::runtime_error("failed"); }, 1ms);
+  REQUIRE_THROWS_AS(result.get(), std::runtime_error);
+
+  /* A failed first attempt is rescued by a successful duplicate. */
+  std::atomic<int> attempts = 0;
+  auto rescued = async::submit_hedged(
+      pool,
+      [&] {
+        if (attempts++ == 0) {
+          std::this_thread::sleep_for(20ms);
+          throw std::runtime_error("failed");
+        }
+        return 3;
+      },
+      1ms);
+  REQUIRE(rescued.get() == 3);
+}
+
+TEST_CASE("hedge.ReleasedWhenFast" * doctest::timeout(25)) {
+  async::ThreadPool pool(2);
+  auto state = std::make_shared<int>(4);
+  auto result = async::submit_hedged(
+      pool, [state] { return *state; }, std::chrono::hours(1));
+  REQUIRE(result.get() == 4);
+  /* Neither the finished attempt nor the timer keeps a copy of the task. */
+  while (state.use_count() > 1) {
+    std::this_thread::yield();
+  }
+}
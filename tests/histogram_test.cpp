@@ -0,0 +1,66 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "async/histogram.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("histogram.Counting") {
+  async::ThreadPool pool(4);
+  std::vector<int> data;
+  std::vector<std::uint64_t> expected(100);
+  for (int i = 0; i < 1000000; i++) {
+    int v = (i * 37) % 120 - 10; /* Includes samples outside [0, 100) */
+    data.push_back(v);
+    if (v >= 0 && v < 100) {
+      expected[v]++;
+    }
+  }
+
+  REQUIRE(async::parallel_histogram(pool, data, 100) == expected);
+}
+
+TEST_CASE("histogram.Range") {
+  async::ThreadPool pool(4);
+  std::vector<double> data;
+  std::vector<std::uint64_t> expected(10);
+  for (int i = 0; i < 500000; i++) {
+    double v = (i % 1200) / 100.0 - 1.0; /* Spans [-1, 11) */
+    data.push_back(v);
+    if (v >= 0.0 && v < 10.0) {
+      expected[static_cast<std::size_t>(v)]++;
+    }
+  }
+
+  REQUIRE(async::parallel_histogram(pool, data, 10, 0.0, 10.0) == expected);
+}
+
+TEST_CASE("histogram.RangeUpperEdge") {
+  /* (v - lo) * scale rounds up to 3 for the largest double below 1. */
+  async::ThreadPool pool(2);
+  std::vector<double> data = {-1.0, std::nextafter(1.0, 0.0), 1.0};
+  REQUIRE(async::parallel_histogram(pool, data, 3, -1.0, 1.0) ==
+          std::vector<std::uint64_t>{1, 0, 1});
+}
+
+TEST_CASE("histogram.AtomicFallback") {
+  /* Enough bins that the privatized copies exceed the limit. */
+  async::ThreadPool pool(8);
+  std::size_t bins = std::size_t{1} << 20;
+  std::vector<std::uint32_t> data;
+  std::vector<std::uint64_t> expected(bins);
+  for (std::uint32_t i = 0; i < 1000000; i++) {
+    std::uint32_t v = (i * 2654435761u) % bins;
+    data.push_back(v);
+    expected[v]++;
+  }
+
+  REQUIRE(async::parallel_histogram(pool, data, bins) == expected);
+}
+
+TEST_CASE("histogram.Empty") {
+  async::ThreadPool pool(2);
+  std::vector<int> data;
+  REQUIRE(async::parallel_histogram(pool, data, 4) ==
+          std::vector<std::uint64_t>(4));
+}
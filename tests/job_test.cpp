@@ -0,0 +1,129 @@
+#include <atomic>
+#include <future>
+#include <stdexcept>
+
+#include "async/job.h"
+#include "doctest/doctest.h"
+
+async::Job<long> fib(int n) {
+  if (n < 2) {
+    co_return n;
+  }
+  long a = 0, b = 0;
+  co_await async::fork(a, fib(n - 1));
+  b = co_await fib(n - 2);
+  co_await async::join();
+  co_return a + b;
+}
+
+TEST_CASE("job.Fib") {
+  for (std::size_t nthreads : {1, 2, 4}) {
+    async::ThreadPool pool(nthreads);
+    REQUIRE(async::run(pool, fib(25)) == 75025);
+  }
+}
+
+async::Job<> increment(std::atomic<int> &counter) {
+  counter.fetch_add(1, std::memory_order_relaxed);
+  co_return;
+}
+
+async::Job<> forkLoop(std::atomic<int> &counter, int n) {
+  for (int i = 0; i < n; i++) {
+    co_await async::fork(increment(counter));
+  }
+  co_await async::join();
+}
+
+TEST_CASE("job.ForkLoop") {
+  async::ThreadPool pool(4);
+  std::atomic<int> counter = 0;
+  async::run(pool, forkLoop(counter, 100000));
+  REQUIRE(counter.load() == 100000);
+}
+
+async::Job<int> thrower(int n) {
+  if (n == 0) {
+    throw std::runtime_error("leaf");
+  }
+  co_return n;
+}
+
+async::Job<int> forkThrower() {
+  int a = 0, b = 0;
+  co_await async::fork(a, thrower(1));
+  co_await async::fork(b, thrower(0));
+  co_await async::join();
+  co_return a + b;
+}
+
+async::Job<int> catchThrower() {
+  try {
+    co_return co_await forkThrower();
+  } catch (std::runtime_error const &) {
+    co_return -1;
+  }
+}
+
+async::Job<> waitForSibling(async::ThreadPool &pool,
+                            std::future<void> &sibling_started) {
+  /* The worker takes the parent back while it waits, and the parent forks
+   * the sibling, leaving another continuation in the same deque slot. */
+  pool.wait(sibling_started);
+  co_return;
+}
+
+async::Job<> signalAndYield(std::promise<void> &started) {
+  started.set_value();
+  co_await async::this_task::yield();
+}
+
+async::Job<int> forkWhileWaiting(async::ThreadPool &pool) {
+  std::promise<void> started;
+  std::future<void> future = started.get_future();
+  co_await async::fork(waitForSibling(pool, future));
+  co_await async::fork(signalAndYield(started));
+  co_await async::join();
+  co_return 1;
+}
+
+TEST_CASE("job.ForkWhileChildWaits" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  auto result =
+      pool.submit([&pool] { return async::run(pool, forkWhileWaiting(pool)); });
+  REQUIRE(result.get() == 1);
+}
+
+TEST_CASE("job.Exception") {
+  async::ThreadPool pool(2);
+  REQUIRE_THROWS_AS(async::run(pool, forkThrower()), std::runtime_error);
+  REQUIRE(async::run(pool, catchThrower()) == -1);
+}
+
+async::Job<int> spinUntilFlagged(async::ThreadPool &pool, bool hard) {
+  std::atomic<bool> flag = false;
+  /* Only this worker can run the task, which it gets to only because the job
+   * yields. */
+  if (hard) {
+    (void)pool.submit_to(async::ThreadPool::current_worker(),
+                         async::Affinity::Hard, [&flag] { flag = true; });
+  } else {
+    (void)pool.submit([&flag] { flag = true; });
+  }
+  int yields = 0;
+  while (!flag.load()) {
+    co_await async::this_task::yield();
+    ++yields;
+  }
+  co_return yields;
+}
+
+TEST_CASE("job.Yield") {
+  async::ThreadPool pool(1);
+  for (bool hard : {true, false}) {
+    auto yields = pool.submit([&pool, hard] {
+      return async::run(pool, spinUntilFlagged(pool, hard));
+    });
+    REQUIRE(yields.get() >= 1);
+  }
+}
@@ -0,0 +1,47 @@
+#include <string>
+#include <vector>
+
+#include "async/keyed.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("keyed.PerKeyOrder" * doctest::timeout(25)) {
+  async::ThreadPool pool(4);
+  constexpr int keys = 64;
+  constexpr int per_key = 1000;
+  std::vector<std::vector<int>> seen(keys);
+  std::vector<std::future<void>> futures;
+  {
+    async::KeyedExecutor<int> executor(pool);
+    for (int i = 0; i < per_key; i++) {
+      for (int k = 0; k < keys; k++) {
+        futures.push_back(
+            executor.submit_keyed(k, [&seen, k, i] { seen[k].push_back(i); }));
+      }
+    }
+  }
+  for (auto &f : futures) {
+    f.get();
+  }
+  for (auto const &s : seen) {
+    REQUIRE(s.size() == per_key);
+    for (int i = 0; i < per_key; i++) {
+      REQUIRE(s[i] == i);
+    }
+  }
+}
+
+TEST_CASE("keyed.HotKeys" * doctest::timeout(25)) {
+  async::ThreadPool pool(2);
+  async::KeyedExecutor<std::string> executor(pool, 8);
+  for (int i = 0; i < 1000; i++) {
+    (void)executor.submit_keyed("hot", [] {});
+    (void)executor.submit_keyed("key" + std::to_string(i), [] {});
+  }
+  auto stats = executor.stats(1);
+  REQUIRE(stats.tasks.size() == 8);
+  REQUIRE(stats.hot_keys.size() == 1);
+  REQUIRE(stats.hot_keys[0].key == "hot");
+  REQUIRE(stats.hot_keys[0].count >= 1000);
+  REQUIRE(stats.hot_keys[0].partition == executor.partition_of("hot"));
+  REQUIRE(stats.imbalance >= 1.0);
+}
@@ -0,0 +1,45 @@
+#include <cstddef>
+#include <vector>
+
+#include "async/linalg.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("linalg.Transpose") {
+  async::ThreadPool pool(4);
+  std::size_t rows = 301, cols = 517;
+  std::vector<int> a(rows * cols), b(rows * cols);
+  for (std::size_t i = 0; i < a.size(); i++) {
+    a[i] = static_cast<int>(i);
+  }
+
+  async::parallel_transpose(pool, rows, cols, a.data(), cols, b.data(), rows);
+
+  for (std::size_t i = 0; i < rows; i++) {
+    for (std::size_t j = 0; j < cols; j++) {
+      REQUIRE(b[j * rows + i] == a[i * cols + j]);
+    }
+  }
+}
+
+TEST_CASE("linalg.Gemm") {
+  async::ThreadPool pool(4);
+  std::size_t m = 133, n = 97, k = 211;
+  std::vector<long> a(m * k), b(k * n), c(m * n, 1), expected(m * n, 1);
+  for (std::size_t i = 0; i < a.size(); i++) {
+    a[i] = static_cast<long>(i % 7) - 3;
+  }
+  for (std::size_t i = 0; i < b.size(); i++) {
+    b[i] = static_cast<long>(i % 5) - 2;
+  }
+  for (std::size_t i = 0; i < m; i++) {
+    for (std::size_t p = 0; p < k; p++) {
+      for (std::size_t j = 0; j < n; j++) {
+        expected[i * n + j] += a[i * k + p] * b[p * n + j];
+      }
+    }
+  }
+
+  async::parallel_gemm(pool, m, n, k, a.data(), k, b.data(), n, c.data(), n);
+
+  REQUIRE(c == expected);
+}
@@ -0,0 +1,86 @@
+#include "async/logger.h"
+
+#if defined(__unix__)
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "doctest/doctest.h"
+
+/* Returns everything written to `file`, one entry per line. */
+static std::vector<std::string> readLines(std::FILE *file) {
+  std::fflush(file);
+  std::rewind(file);
+  std::vector<std::string> lines;
+  char buffer[512];
+  while (std::fgets(buffer, sizeof buffer, file)) {
+    lines.emplace_back(buffer);
+  }
+  return lines;
+}
+
+TEST_CASE("logger.Format") {
+  async::ThreadPool pool(1);
+  std::FILE *file = std::tmpfile();
+  {
+    async::Logger logger(pool, fileno(file));
+    logger.log("int {} double {} bool {} char {} str {}", -42, 2.5, true, 'x',
+               "hi");
+    logger.log("no arguments");
+    logger.log("extra {} {}", 1);
+  }
+  std::vector<std::string> lines = readLines(file);
+  std::fclose(file);
+  REQUIRE(lines.size() == 3);
+
+  /* `<seconds>.<microseconds> <worker> <message>`; the caller is not a
+   * worker. */
+  std::istringstream prefix(lines[0]);
+  std::string time, worker;
+  prefix >> time >> worker;
+  REQUIRE(time.size() > 7);
+  REQUIRE(time[time.size() - 7] == '.');
+  REQUIRE(worker == "-");
+  auto message = [](std::string const &line) {
+    std::size_t first = line.find(' ');
+    return line.substr(line.find(' ', first + 1) + 1);
+  };
+  REQUIRE(message(lines[0]) ==
+          "int -42 double 2.5 bool true char x str hi\n");
+  REQUIRE(message(lines[1]) == "no arguments\n");
+  REQUIRE(message(lines[2]) == "extra 1 {}\n");
+}
+
+TEST_CASE("logger.Workers" * doctest::timeout(25)) {
+  constexpr int N = 2000;
+  async::ThreadPool pool(4);
+  std::FILE *file = std::tmpfile();
+  async::Logger logger(pool, fileno(file), {.ring_records = N});
+  async::TaskGroup group(pool);
+  for (int i = 0; i < N; i++) {
+    group.run([&logger, i] { logger.log("task {}", i); });
+  }
+  group.wait();
+  logger.flush();
+  std::vector<std::string> lines = readLines(file);
+  std::fclose(file);
+
+  REQUIRE(logger.dropped() == 0);
+  REQUIRE(lines.size() == N);
+  std::vector<bool> seen(N);
+  for (std::string const &line : lines) {
+    std::istringstream in(line);
+    std::string time, worker, word;
+    int i = -1;
+    in >> time >> worker >> word >> i;
+    /* wait() also runs tasks on the calling thread, outside the pool. */
+    REQUIRE((worker == "-" || std::stoul(worker) < pool.size()));
+    REQUIRE(word == "task");
+    REQUIRE((i >= 0 && i < N && !seen[i]));
+    seen[i] = true;
+  }
+}
+
+#endif
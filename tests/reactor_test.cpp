@@ -0,0 +1,126 @@
+#include "async/reactor.h"
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "async/job.h"
+#include "doctest/doctest.h"
+
+/* A connected pair of loopback TCP sockets; the server end is non-blocking. */
+struct Connection {
+  int client = -1;
+  int server = -1;
+
+  Connection() {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof addr;
+    bind(listener, reinterpret_cast<sockaddr *>(&addr), len);
+    listen(listener, 1);
+    getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len);
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    connect(client, reinterpret_cast<sockaddr *>(&addr), len);
+    server = accept(listener, nullptr, nullptr);
+    close(listener);
+    fcntl(server, F_SETFL, fcntl(server, F_GETFL) | O_NONBLOCK);
+  }
+
+  Connection(Connection const &other) = delete;
+  Connection &operator=(Connection const &other) = delete;
+
+  ~Connection() {
+    close(client);
+    close(server);
+  }
+
+  /* Sends `message` from the client and returns what comes back. */
+  std::string roundTrip(std::string const &message) {
+    write(client, message.data(), message.size());
+    std::string reply(message.size(), '\0');
+    std::size_t got = 0;
+    while (got < reply.size()) {
+      ssize_t n = read(client, reply.data() + got, reply.size() - got);
+      if (n <= 0) {
+        break;
+      }
+      got += static_cast<std::size_t>(n);
+    }
+    return reply.substr(0, got);
+  }
+};
+
+TEST_CASE("reactor.Echo" * doctest::timeout(25)) {
+  /* Many connections per worker, each echoed by a callback on the pool. */
+  async::ThreadPool pool(2);
+  std::vector<Connection> connections(32);
+  std::atomic<int> off_pool = 0;
+  {
+    async::Reactor reactor(pool);
+    for (Connection &c : connections) {
+      reactor.add(c.server, async::Interest::Read,
+                  [&pool, &off_pool, fd = c.server](std::uint32_t) {
+                    if (async::ThreadPool::current() != &pool) {
+                      off_pool++;
+                    }
+                    char buffer[256];
+                    ssize_t n;
+                    while ((n = read(fd, buffer, sizeof buffer)) > 0) {
+                      write(fd, buffer, static_cast<std::size_t>(n));
+                    }
+                  });
+    }
+    for (int round = 0; round < 3; ++round) {
+      for (std::size_t i = 0; i < connections.size(); ++i) {
+        std::string message = "ping " + std::to_string(i);
+        REQUIRE(connections[i].roundTrip(message) == message);
+      }
+    }
+    /* Tasks still run while a worker waits in the poller. */
+    REQUIRE(pool.submit([] { return 7; }).get() == 7);
+    for (Connection &c : connections) {
+      reactor.remove(c.server);
+    }
+  }
+  REQUIRE(off_pool == 0);
+}
+
+async::Job<std::string> readLine(async::Reactor &reactor, int fd) {
+  std::string line;
+  while (line.empty() || line.back() != '\n') {
+    co_await reactor.ready(fd, async::Interest::Read);
+    char buffer[64];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof buffer)) > 0) {
+      line.append(buffer, static_cast<std::size_t>(n));
+    }
+  }
+  co_return line;
+}
+
+TEST_CASE("reactor.Await" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  async::Reactor reactor(pool);
+  Connection c;
+  write(c.client, "hello ", 6);
+  /* The rest arrives while the coroutine is suspended. */
+  std::jthread writer([&c] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    write(c.client, "world\n", 6);
+  });
+  REQUIRE(async::run(pool, readLine(reactor, c.server)) == "hello world\n");
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "async/strand.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("strand.Serial" * doctest::timeout(25)) {
+  async::ThreadPool pool(4);
+  constexpr int producers = 4;
+  constexpr int per_producer = 20000;
+
+  /* Unsynchronized state, touched only by the strand's tasks. */
+  long counter = 0;
+  std::vector<std::vector<int>> seen(producers);
+  {
+    async::Strand strand(pool);
+    std::vector<std::jthread> threads;
+    for (int p = 0; p < producers; p++) {
+      threads.emplace_back([&, p] {
+        for (int i = 0; i < per_producer; i++) {
+          strand.post([&, p, i] {
+            counter++;
+            seen[p].push_back(i);
+          });
+        }
+      });
+    }
+  }
+
+  REQUIRE(counter == producers * per_producer);
+  for (auto const &s : seen) {
+    REQUIRE(s.size() == per_producer);
+    for (int i = 0; i < per_producer; i++) {
+      REQUIRE(s[i] == i);
+    }
+  }
+}
+
+TEST_CASE("strand.Submit" * doctest::timeout(25)) {
+  async::ThreadPool pool(2);
+  async::Strand strand(pool);
+  auto value = strand.submit([](int x) { return x * 2; }, 21);
+  auto error = strand.submit([] { throw std::runtime_error("strand"); });
+  REQUIRE(value.get() == 42);
+  REQUIRE_THROWS_AS(error.get(), std::runtime_error);
+
+  /* Posting from the strand's own tasks, on a pool worker. */
+  int depth = 0;
+  auto nested = strand.submit([&] {
+    strand.post([&] { depth++; });
+  });
+  nested.get();
+  REQUIRE(strand.submit([&] { return depth; }).get() == 1);
+}
@@ -1,4 +1,13 @@
 #include <iostream>
+#include <string>
+#include <tuple>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "async/threadpool.h"
 #include "doctest/doctest.h"
@@ -115,4 +124,352 @@ TEST_CASE("threadpool.VaryingWait.8Threads") {
 
 TEST_CASE("threadpool.VaryingWait.16Threads") {
   test_with_varying_wait_periods(16);
-}
\ No newline at end of file
+}
+
+int fib(async::ThreadPool &pool, int n) {
+  if (n < 2) {
+    return n;
+  }
+  int x = 0;
+  async::TaskGroup group(pool);
+  group.run([&] { x = fib(pool, n - 1); });
+  int y = fib(pool, n - 2);
+  group.wait();
+  return x + y;
+}
+
+TEST_CASE("threadpool.TaskGroupFib" * doctest::timeout(25)) {
+  async::ThreadPool pool(4);
+  REQUIRE(pool.submit([&] { return fib(pool, 20); }).get() == 6765);
+
+  /* Waiting from outside the pool */
+  REQUIRE(fib(pool, 15) == 610);
+}
+
+TEST_CASE("threadpool.TaskGroupException") {
+  async::ThreadPool pool(2);
+  async::TaskGroup group(pool);
+  std::atomic<int> ran = 0;
+  for (int i = 0; i < 100; i++) {
+    group.run([&, i] {
+      ran++;
+      if (i == 50) {
+        throw std::runtime_error("task failed");
+      }
+    });
+  }
+  REQUIRE_THROWS_AS(group.wait(), std::runtime_error);
+  REQUIRE(ran == 100);
+}
+
+TEST_CASE("threadpool.CurrentPool") {
+  async::ThreadPool pool(2);
+  REQUIRE(async::ThreadPool::current() == nullptr);
+  REQUIRE(&async::this_pool() == &async::default_pool());
+  REQUIRE(pool.submit([] { return async::ThreadPool::current(); }).get() ==
+          &pool);
+  REQUIRE(pool.submit([] { return &async::this_pool(); }).get() == &pool);
+}
+
+TEST_CASE("threadpool.WaitInsideTask" * doctest::timeout(25)) {
+  /* With a single worker, blocking on the inner future would deadlock. */
+  async::ThreadPool pool(1);
+  auto outer = pool.submit([&pool] {
+    auto inner = pool.submit([] { return 42; });
+    pool.wait(inner);
+    return inner.get();
+  });
+  REQUIRE(outer.get() == 42);
+}
+
+TEST_CASE("threadpool.Prewarm" * doctest::timeout(25)) {
+  async::ThreadPool pool(8);
+  pool.prewarm();
+  pool.prewarm(); /* Again, once the workers are running */
+  REQUIRE(pool.submit([] { return 7; }).get() == 7);
+}
+
+TEST_CASE("threadpool.SingleSearchingWorker" * doctest::timeout(25)) {
+  async::ThreadPool pool(8);
+  pool.set_max_searching(1);
+  auto result = pool.submit([&] { return fib(pool, 20); });
+
+  /* Idle workers keep looking for the tasks that fib() spawns, but only one
+   * of them may do so at a time. */
+  std::size_t most_searching = 0;
+  while (result.wait_for(std::chrono::seconds(0)) !=
+         std::future_status::ready) {
+    most_searching = std::max(most_searching, pool.stats().searching);
+  }
+  REQUIRE(result.get() == 6765);
+  REQUIRE(most_searching <= 1);
+}
+
+TEST_CASE("threadpool.SubmitTo" * doctest::timeout(25)) {
+  async::ThreadPool pool(4);
+  std::vector<std::future<std::size_t>> hard, soft;
+  for (std::size_t i = 0; i < 400; i++) {
+    hard.push_back(pool.submit_to(i % 4, async::Affinity::Hard, [] {
+      return async::ThreadPool::current_worker();
+    }));
+    soft.push_back(pool.submit_to(i % 4, [](std::size_t x) { return x; }, i));
+  }
+  for (std::size_t i = 0; i < 400; i++) {
+    REQUIRE(hard[i].get() == i % 4);
+    REQUIRE(soft[i].get() == i);
+  }
+}
+
+/* Occupies the only worker of `pool` until `release` is set. */
+void occupyWorker(async::ThreadPool &pool, std::atomic<bool> &release) {
+  std::atomic<bool> started = false;
+  (void)pool.submit([&] {
+    started = true;
+    while (!release) {
+      std::this_thread::yield();
+    }
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+}
+
+TEST_CASE("threadpool.AdmissionReject" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  pool.set_admission({.max_queued = 2, .overflow = async::Overflow::Reject});
+  std::atomic<bool> release = false;
+  occupyWorker(pool, release);
+  auto a = pool.submit([] { return 1; });
+  auto b = pool.submit([] { return 2; });
+  REQUIRE_THROWS_AS(pool.submit([] { return 3; }), async::QueueFullError);
+  release = true;
+  REQUIRE(a.get() + b.get() == 3);
+}
+
+TEST_CASE("threadpool.AdmissionCallerRuns" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  pool.set_admission(
+      {.max_queued = 1, .overflow = async::Overflow::CallerRuns});
+  std::atomic<bool> release = false;
+  occupyWorker(pool, release);
+  auto queued = pool.submit([] { return std::this_thread::get_id(); });
+  auto inline_run = pool.submit([] { return std::this_thread::get_id(); });
+  REQUIRE(inline_run.get() == std::this_thread::get_id());
+  release = true;
+  REQUIRE(queued.get() != std::this_thread::get_id());
+}
+
+TEST_CASE("threadpool.AdmissionDropOldest" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  pool.set_admission(
+      {.max_queued = 3, .overflow = async::Overflow::DropOldest});
+  std::atomic<bool> release = false;
+  occupyWorker(pool, release);
+  std::vector<int> order; // Only written by the single worker
+  pool.spawn([&] { order.push_back(0); });
+  auto oldest = pool.submit([] { return 1; });
+  auto b = pool.submit([&] {
+    order.push_back(2);
+    return 2;
+  });
+  auto c = pool.submit([&] {
+    order.push_back(3);
+    return 3;
+  });
+  release = true;
+  REQUIRE_THROWS_AS(oldest.get(), std::future_error);
+  REQUIRE(b.get() + c.get() == 5);
+  /* The spawned task may not be dropped, and still runs first. */
+  REQUIRE(order == std::vector<int>{0, 2, 3});
+}
+
+TEST_CASE("threadpool.Coalescing" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  pool.set_coalescing(4);
+  std::atomic<bool> release = false;
+  occupyWorker(pool, release);
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 1000; i++) {
+    results.push_back(pool.submit([i] { return i; }));
+  }
+  /* The first tasks are queued one by one, the rest in batches. */
+  REQUIRE(pool.queued() <= 4 + 1000 / async::ThreadPool::COALESCE_BATCH + 1);
+  release = true;
+  long sum = 0;
+  for (auto &result : results) {
+    sum += result.get();
+  }
+  REQUIRE(sum == 999 * 1000 / 2);
+
+  /* Once the pool is idle, tasks are queued one by one again. */
+  pool.set_coalescing(0);
+  REQUIRE(pool.submit([] { return 1; }).get() == 1);
+}
+
+TEST_CASE("threadpool.ConcurrentSubmitters" * doctest::timeout(25)) {
+  /* Threads outside the pool and tasks inside it submit at the same time,
+   * with and without coalescing. */
+  for (std::size_t coalesce : {0, 1}) {
+    async::ThreadPool pool(2);
+    pool.set_coalescing(coalesce);
+    std::atomic<long> sum = 0;
+    auto submitMany = [&pool, &sum] {
+      std::vector<std::future<void>> futures;
+      for (int i = 1; i <= 5000; i++) {
+        futures.push_back(pool.submit([&sum, i] { sum += i; }));
+      }
+      for (auto &future : futures) {
+        pool.wait(future);
+      }
+    };
+    {
+      std::vector<std::jthread> submitters;
+      for (int t = 0; t < 3; t++) {
+        submitters.emplace_back(submitMany);
+      }
+      pool.submit(submitMany).get();
+    }
+    REQUIRE(sum == 4 * 5000L * 5001 / 2);
+  }
+}
+
+TEST_CASE("threadpool.AdmissionBlock" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  std::atomic<int> high = 0, low = 0;
+  pool.set_admission({.max_queued = 2,
+                      .overflow = async::Overflow::Block,
+                      .high_watermark = 2,
+                      .low_watermark = 0,
+                      .on_high = [&](std::size_t) { high++; },
+                      .on_low = [&](std::size_t) { low++; }});
+  std::atomic<bool> release = false;
+  occupyWorker(pool, release);
+  (void)pool.submit([] {});
+  (void)pool.submit([] {});
+  REQUIRE(high == 1);
+
+  std::atomic<bool> submitted = false;
+  std::jthread submitter([&] {
+    pool.submit([] {}).get();
+    submitted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  REQUIRE(!submitted);
+  release = true;
+  submitter.join();
+  REQUIRE(submitted);
+  while (pool.queued() > 0) {
+    std::this_thread::yield();
+  }
+  REQUIRE(low >= 1);
+}
+
+TEST_CASE("threadpool.AdmissionChange" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  pool.set_admission({.max_queued = 1, .overflow = async::Overflow::Block});
+  std::atomic<bool> release = false;
+  occupyWorker(pool, release);
+  auto queued = pool.submit([] { return 1; });
+
+  std::atomic<bool> submitted = false;
+  std::future<int> blocked;
+  std::jthread submitter([&] {
+    blocked = pool.submit([] { return 2; });
+    submitted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  REQUIRE(!submitted);
+  /* Lifting the limit lets the blocked submitter through while the worker is
+   * still busy. */
+  pool.set_admission({});
+  submitter.join();
+  REQUIRE(submitted);
+  release = true;
+  REQUIRE(queued.get() + blocked.get() == 3);
+}
+
+TEST_CASE("threadpool.ShouldYield" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  REQUIRE(!async::this_task::should_yield());
+  std::atomic<bool> started = false, yielded = false;
+  auto long_task = pool.submit([&] {
+    bool alone = !async::this_task::should_yield();
+    started = true;
+    while (!async::this_task::should_yield()) {
+    }
+    yielded = true;
+    return alone;
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  REQUIRE(!yielded);
+  auto short_task = pool.submit([] {});
+  REQUIRE(long_task.get());
+  short_task.get();
+  REQUIRE(yielded);
+}
+
+#if defined(__linux__)
+TEST_CASE("threadpool.WorkerOptions" * doctest::timeout(25)) {
+  std::atomic<int> started = 0, stopped = 0;
+  {
+    /* Not a whole number of pages: rounded up rather than ignored. */
+    async::ThreadPool pool(2, {.stack_size = 512 * 1024 + 1,
+                               .name = "tp",
+                               .nice = 5,
+                               .on_start = [&](std::size_t) { started++; },
+                               .on_stop = [&](std::size_t) { stopped++; }});
+    pool.prewarm();
+    REQUIRE(started == 2);
+    for (std::size_t worker = 0; worker < pool.size(); worker++) {
+      auto settings = pool.submit_to(worker, async::Affinity::Hard, [] {
+        char name[16] = {};
+        pthread_getname_np(pthread_self(), name, sizeof name);
+        pthread_attr_t attr;
+        std::size_t stack_size = 0;
+        pthread_getattr_np(pthread_self(), &attr);
+        pthread_attr_getstacksize(&attr, &stack_size);
+        pthread_attr_destroy(&attr);
+        int nice =
+            getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+        return std::tuple(std::string(name), stack_size, nice);
+      });
+      auto [name, stack_size, nice] = settings.get();
+      REQUIRE(name == "tp-" + std::to_string(worker));
+      REQUIRE(stack_size ==
+              512 * 1024 + static_cast<std::size_t>(sysconf(_SC_PAGESIZE)));
+      REQUIRE(nice >= 5);
+    }
+  }
+  REQUIRE(stopped == 2);
+}
+
+TEST_CASE("threadpool.WorkerStartFailure" * doctest::timeout(25)) {
+  /* No thread can get a stack this large. */
+  for (std::size_t stack_size : {std::size_t{1} << 50, SIZE_MAX}) {
+    async::ThreadPool pool(4, {.stack_size = stack_size});
+    REQUIRE_THROWS_AS(pool.submit([] {}), std::system_error);
+    REQUIRE_THROWS_AS(pool.prewarm(), std::system_error);
+    REQUIRE_THROWS_AS(pool.submit([] {}), std::system_error);
+  }
+}
+#endif
+
+TEST_CASE("threadpool.WorkSharing" * doctest::timeout(25)) {
+  for (bool push_to_parked : {false, true}) {
+    async::ThreadPool pool(4);
+    pool.set_work_sharing(
+        {.surplus_threshold = 8, .push_to_parked = push_to_parked});
+    std::atomic<long> sum = 0;
+    pool.submit([&] {
+          async::TaskGroup group(pool);
+          for (int i = 1; i <= 10000; i++) {
+            group.run([&sum, i] { sum += i; });
+          }
+          group.wait();
+        }).get();
+    REQUIRE(sum == 10000L * 10001 / 2);
+  }
+}
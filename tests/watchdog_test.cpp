@@ -0,0 +1,69 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async/watchdog.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("watchdog.Report" * doctest::timeout(25)) {
+  async::ThreadPool pool(2);
+  std::mutex mutex;
+  std::vector<async::StallReport> reports;
+  {
+    async::Watchdog watchdog(
+        pool, {.threshold = std::chrono::milliseconds(20),
+               .on_stall = [&](async::StallReport const &report) {
+                 std::lock_guard lock(mutex);
+                 reports.push_back(report);
+               }});
+    /* Short tasks are not reported. */
+    for (int i = 0; i < 1000; i++) {
+      pool.submit([] {}).get();
+    }
+    std::atomic<bool> release = false;
+    auto stuck = pool.submit([&] {
+      async::this_task::set_tag("stuck");
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+    while (watchdog.stalled() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    release = true;
+    stuck.get();
+  }
+  std::lock_guard lock(mutex);
+  REQUIRE(reports.size() == 1);
+  REQUIRE(reports[0].running >= std::chrono::milliseconds(20));
+  REQUIRE(std::string(reports[0].tag) == "stuck");
+}
+
+TEST_CASE("watchdog.Elastic" * doctest::timeout(25)) {
+  async::ThreadPool pool(1);
+  async::Watchdog watchdog(
+      pool, {.threshold = std::chrono::milliseconds(10), .elastic = true});
+  std::atomic<bool> release = false;
+  std::atomic<bool> started = false;
+  auto stuck = pool.submit([&] {
+    started = true;
+    while (!release) {
+      std::this_thread::yield();
+    }
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  /* Queued behind the stuck task on the only worker; run by the replacement.
+   * The task releases the stuck one, so it cannot run on the stuck worker. */
+  auto queued = pool.submit([&] {
+    release = true;
+    return async::ThreadPool::current() == nullptr;
+  });
+  REQUIRE(queued.get());
+  stuck.get();
+  REQUIRE(watchdog.replacements() == 1);
+}